@@ -0,0 +1,86 @@
+/// @file
+/// @brief Measures frame copy throughput.
+/// Compares `memcpy` against the driver's CopyEngine for a range of frame
+/// sizes and worker counts. Reports GB/s.
+
+#include "src/copy.engine.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+double
+measure_gbps(size_t nbytes, const std::function<void()>& copy)
+{
+    using clock = std::chrono::steady_clock;
+    // Repeat until at least ~2 GB have been moved so small frames aren't
+    // dominated by timer resolution.
+    const size_t reps = std::max<size_t>(3, (2ULL << 30) / nbytes);
+    copy(); // warm up: fault in pages, wake workers
+    const auto t0 = clock::now();
+    for (size_t i = 0; i < reps; ++i)
+        copy();
+    const std::chrono::duration<double> dt = clock::now() - t0;
+    return 1e-9 * (double)(nbytes * reps) / dt.count();
+}
+
+} // end anonymous namespace
+
+int
+main(int argc, char* argv[])
+{
+    // 14192 x 10640 u16 is the full frame of the VP-151MX.
+    std::vector<size_t> sizes = {
+        256ULL << 10, 1ULL << 20,  4ULL << 20,          16ULL << 20,
+        64ULL << 20,  256ULL << 20, 14192ULL * 10640 * 2,
+    };
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i)
+            sizes.push_back((size_t)(std::atof(argv[i]) * (1 << 20)));
+    }
+
+    const size_t max_size = *std::max_element(sizes.begin(), sizes.end());
+    std::unique_ptr<uint8_t[]> src(new uint8_t[max_size]);
+    std::unique_ptr<uint8_t[]> dst(new uint8_t[max_size]);
+    std::memset(src.get(), 0xa5, max_size);
+    std::memset(dst.get(), 0, max_size);
+
+    const size_t hw = std::thread::hardware_concurrency();
+    std::vector<size_t> thread_counts = { 1, 2, 4 };
+    if (hw > 8)
+        thread_counts.push_back(8);
+
+    printf("%12s %10s %10s", "size (MB)", "memcpy", "nt x1");
+    for (auto n : thread_counts)
+        printf(" %9s%zu", "pool x", n + 1);
+    printf("   (GB/s)\n");
+
+    for (auto nbytes : sizes) {
+        printf("%12.2f", 1e-6 * (double)nbytes);
+        printf(" %10.2f", measure_gbps(nbytes, [&] {
+                   std::memcpy(dst.get(), src.get(), nbytes);
+               }));
+        printf(" %10.2f", measure_gbps(nbytes, [&] {
+                   CopyEngine::copy_nt(dst.get(), src.get(), nbytes);
+               }));
+        for (auto n : thread_counts) {
+            // A threshold of 0 forces the parallel path.
+            CopyEngine engine(n, 0);
+            printf(" %10.2f", measure_gbps(nbytes, [&] {
+                       engine.copy(dst.get(), src.get(), nbytes);
+                   }));
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
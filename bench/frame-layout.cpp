@@ -0,0 +1,121 @@
+/// @file
+/// @brief Measures the per-frame cost of describing an image.
+/// Compares resolving the pixel format and shape for every frame, as
+/// `get_frame` used to, against filling in a `FrameLayout` resolved once at
+/// start. Only the host-side work is measured; the grabber queries the old
+/// path also made (`getInfo`) aren't available without hardware and would
+/// widen the gap.
+
+#include "src/frame.layout.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Stands in for Euresys::BufferInfo.
+struct FakeBufferInfo
+{
+    void* base;
+    size_t size;
+    size_t width;
+    size_t height;
+    std::string pixelFormat;
+};
+
+const std::unordered_map<std::string, SampleType> px_type_table = {
+    { "Mono8", SampleType_u8 },   { "Mono10", SampleType_u10 },
+    { "Mono12", SampleType_u12 }, { "Mono14", SampleType_u14 },
+    { "Mono16", SampleType_u16 },
+};
+
+// What describing a frame looked like before the layout was cached.
+void
+describe_per_frame(const FakeBufferInfo& buf,
+                   uint64_t timestamp_ns,
+                   uint64_t frame_id,
+                   const void** data,
+                   size_t* nbytes,
+                   struct ImageInfo* info)
+{
+    const auto it = px_type_table.find(buf.pixelFormat);
+    const auto type = it == px_type_table.end() ? SampleType_Unknown
+                                                : it->second;
+    *data = buf.base;
+    *nbytes = buf.size;
+    *info = {
+        .shape = {
+            .dims = { .channels = 1,
+                      .width = (uint32_t)buf.width,
+                      .height = (uint32_t)buf.height,
+                      .planes = 1 },
+            .strides = { .channels = 1,
+                         .width = 1,
+                         .height = (int64_t)buf.width,
+                         .planes = (int64_t)(buf.width * buf.height) },
+            .type = type,
+        },
+        .hardware_timestamp = timestamp_ns,
+        .hardware_frame_id = frame_id,
+    };
+}
+
+template<typename F>
+double
+measure_ns_per_frame(size_t nframes, F&& describe)
+{
+    using clock = std::chrono::steady_clock;
+    describe(0); // warm up
+    const auto t0 = clock::now();
+    for (size_t i = 0; i < nframes; ++i)
+        describe(i);
+    const std::chrono::duration<double, std::nano> dt = clock::now() - t0;
+    return dt.count() / (double)nframes;
+}
+
+} // end anonymous namespace
+
+int
+main(int argc, char* argv[])
+{
+    const size_t nframes =
+      argc > 1 ? (size_t)std::atof(argv[1]) : (size_t)10'000'000;
+
+    std::vector<uint8_t> buffer(64);
+    const FakeBufferInfo buf = {
+        .base = buffer.data(),
+        .size = 14192ULL * 10640 * 2,
+        .width = 14192,
+        .height = 10640,
+        // Long enough to defeat the small-string optimization, as the
+        // packed and vendor formats do.
+        .pixelFormat = "Mono16_with_a_long_vendor_suffix",
+    };
+    const FrameLayout layout(
+      14192, 10640, SampleType_u16, 2, PixelPacking::None, 1);
+
+    // Results are accumulated so the compiler can't drop the work.
+    const void* data = nullptr;
+    size_t nbytes = 0;
+    struct ImageInfo info = {};
+    uint64_t sink = 0;
+
+    const double before = measure_ns_per_frame(nframes, [&](size_t i) {
+        describe_per_frame(buf, i, i, &data, &nbytes, &info);
+        sink += info.shape.type + info.hardware_frame_id + nbytes;
+    });
+    const double after = measure_ns_per_frame(nframes, [&](size_t i) {
+        layout.describe(buf.base, 0, i, i, &data, &nbytes, &info);
+        sink += info.shape.type + info.hardware_frame_id + nbytes;
+    });
+
+    printf("%24s %10s\n", "", "ns/frame");
+    printf("%24s %10.2f\n", "lookup per frame", before);
+    printf("%24s %10.2f\n", "cached layout", after);
+    printf("(checksum %llu)\n", (unsigned long long)sink);
+    return 0;
+}
@@ -0,0 +1,745 @@
+/// @file
+/// @brief Measures the driver's frame path: throughput, `get_frame` latency
+/// and dropped frames.
+/// Loads the driver, opens the first camera and sweeps frame size, pixel
+/// type, buffer count and a simulated consumer delay. Each case streams
+/// free-running for a few seconds while a consumer calls `get_frame` in a
+/// loop, sleeping for the consumer delay after every frame.
+///
+/// The sweep is repeated for each acquisition mode in `--modes` (pop, with
+/// the driver's acquisition thread, and callback, with the grabber's
+/// callbacks), reopening the camera in between. Each mode also measures
+/// software trigger to frame latency over `--triggers` triggers, which is
+/// where the two differ most.
+///
+/// With `--priority N`, the thread receiving buffers runs at real-time
+/// priority N. Each case reports the receive jitter and run queue wait the
+/// driver measured, to compare against a run at normal priority.
+///
+/// Results are printed as a table and can be written as JSON with
+/// `--json FILE`. With `--baseline FILE`, each case is compared against the
+/// same case in an earlier JSON file, and the exit code is non-zero if any
+/// case lost more than `--tolerance` (default 0.1) of its frame rate or
+/// started dropping frames.
+///
+/// Without a frame grabber, build with `-DEGRABBER_SIMULATED=ON` and raise
+/// `ACQUIRE_EGRABBER_SIM_FPS` to measure the driver rather than the camera's
+/// frame rate.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    // Only errors. The driver logs every start and stop.
+    if (is_error)
+        fprintf(stderr, "ERROR %s(%d) - %s: %s\n", file, line, function, msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+struct Options
+{
+    std::vector<uint32_t> sizes = { 512, 1024, 2048 };
+    std::vector<SampleType> types = { SampleType_u8,
+                                      SampleType_u12,
+                                      SampleType_u16 };
+    std::vector<uint32_t> buffers = { 4, 16, 64 };
+    std::vector<double> delays_us = { 0, 1000 };
+    double seconds = 2;
+    float exposure_us = 100;
+    std::string json_path;
+    std::string baseline_path;
+    double tolerance = 0.1;
+    std::vector<enum EGrabberAcquisitionMode> modes = {
+        EGrabberAcquisition_Pop,
+        EGrabberAcquisition_Callback,
+    };
+    uint32_t triggers = 200;
+    int32_t priority = 0;
+};
+
+struct Case
+{
+    uint32_t size;
+    SampleType type;
+    uint32_t buffers;
+    double delay_us;
+};
+
+struct Result
+{
+    std::string name;
+    uint32_t width, height;
+    uint64_t frames;
+    double seconds;
+    double mb_per_s;
+    double frames_per_s;
+    double p50_us, p99_us, p999_us, max_us;
+    uint64_t queue_overflows;
+    uint64_t frames_lost;
+    double jitter_mean_us, jitter_max_us;
+    double run_queue_wait_ms;
+    bool realtime;
+    uint32_t data_streams;
+};
+
+struct TriggerResult
+{
+    enum EGrabberAcquisitionMode mode;
+    uint64_t frames;
+    double mean_us, max_us;
+};
+
+const char*
+mode_name(enum EGrabberAcquisitionMode mode)
+{
+    return mode == EGrabberAcquisition_Callback ? "callback" : "pop";
+}
+
+bool
+parse_mode(const std::string& s, enum EGrabberAcquisitionMode* out)
+{
+    for (auto m : { EGrabberAcquisition_Pop, EGrabberAcquisition_Callback }) {
+        if (s == mode_name(m)) {
+            *out = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char*
+type_name(SampleType t)
+{
+    switch (t) {
+        case SampleType_u8:
+            return "u8";
+        case SampleType_u10:
+            return "u10";
+        case SampleType_u12:
+            return "u12";
+        case SampleType_u14:
+            return "u14";
+        case SampleType_u16:
+            return "u16";
+        default:
+            return "unknown";
+    }
+}
+
+bool
+parse_type(const std::string& s, SampleType* out)
+{
+    for (auto t : { SampleType_u8,
+                    SampleType_u10,
+                    SampleType_u12,
+                    SampleType_u14,
+                    SampleType_u16 }) {
+        if (s == type_name(t)) {
+            *out = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T, typename Parse>
+std::vector<T>
+parse_list(const char* arg, Parse&& parse)
+{
+    std::vector<T> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        out.push_back(parse(item));
+    return out;
+}
+
+double
+percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    const size_t i = (size_t)std::ceil(p * (double)sorted.size()) - 1;
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+struct Api
+{
+    egrabber_camera_set_buffer_policy_t set_buffer_policy;
+    egrabber_camera_get_buffer_policy_t get_buffer_policy;
+    egrabber_camera_get_stats_t get_stats;
+    egrabber_camera_try_get_frame_t try_get_frame;
+    egrabber_driver_set_acquisition_mode_t set_acquisition_mode;
+    egrabber_camera_set_thread_priority_t set_thread_priority;
+};
+
+bool
+run_case(struct Camera* camera,
+         const Api& api,
+         const Options& opts,
+         enum EGrabberAcquisitionMode mode,
+         const Case& c,
+         Result* out)
+{
+    using namespace std::chrono;
+
+    struct CameraPropertyMetadata meta = {};
+    struct CameraProperties props = {};
+    if (camera->get_meta(camera, &meta) != Device_Ok ||
+        camera->get(camera, &props) != Device_Ok)
+        return false;
+    props.pixel_type = c.type;
+    props.binning = 1;
+    props.exposure_time_us = opts.exposure_us;
+    props.offset = { .x = 0, .y = 0 };
+    props.shape = { .x = std::min(c.size, (uint32_t)meta.shape.x.high),
+                    .y = std::min(c.size, (uint32_t)meta.shape.y.high) };
+    props.input_triggers.frame_start.enable = 0;
+    if (camera->set(camera, &props) != Device_Ok)
+        return false;
+
+    struct EGrabberBufferPolicy policy = {};
+    api.get_buffer_policy(camera, &policy);
+    policy.budget_bytes = 0;
+    policy.seconds = 0;
+    policy.min_count = policy.max_count = c.buffers;
+    policy.images_per_buffer = 1;
+    if (api.set_buffer_policy(camera, &policy) != Device_Ok)
+        return false;
+
+    struct ImageShape shape = {};
+    if (camera->get_shape(camera, &shape) != Device_Ok)
+        return false;
+    // Room for 16-bit pixels whatever the type.
+    std::vector<uint8_t> im((size_t)shape.dims.width * shape.dims.height * 2);
+
+    if (camera->start(camera) != Device_Ok)
+        return false;
+
+    const auto consume = [&](std::vector<double>* latencies_us,
+                             uint64_t* bytes,
+                             steady_clock::time_point until) {
+        while (steady_clock::now() < until) {
+            struct ImageInfo info = {};
+            size_t nbytes = im.size();
+            const auto t0 = steady_clock::now();
+            const auto status =
+              api.try_get_frame(camera, im.data(), &nbytes, &info, 1000);
+            const auto t1 = steady_clock::now();
+            if (status != EGrabberFrame_Ok)
+                return status == EGrabberFrame_Timeout;
+            if (latencies_us) {
+                latencies_us->push_back(
+                  duration<double, std::micro>(t1 - t0).count());
+                *bytes += nbytes;
+            }
+            if (c.delay_us > 0)
+                std::this_thread::sleep_for(
+                  duration<double, std::micro>(c.delay_us));
+        }
+        return true;
+    };
+
+    // Warm up: fault in the buffers, fill the pipeline.
+    bool ok = consume(nullptr, nullptr, steady_clock::now() + milliseconds(250));
+
+    struct EGrabberStats before = {};
+    api.get_stats(camera, &before);
+    std::vector<double> latencies_us;
+    latencies_us.reserve(1 << 16);
+    uint64_t bytes = 0;
+    const auto t0 = steady_clock::now();
+    ok = ok && consume(&latencies_us,
+                       &bytes,
+                       t0 + duration_cast<steady_clock::duration>(
+                              duration<double>(opts.seconds)));
+    const double seconds = duration<double>(steady_clock::now() - t0).count();
+    struct EGrabberStats after = {};
+    api.get_stats(camera, &after);
+    ok = camera->stop(camera) == Device_Ok && ok;
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    // Pop mode cases keep the names they had before there were modes, so
+    // older baselines still match.
+    char name[128];
+    snprintf(name,
+             sizeof(name),
+             "%ux%u-%s-b%u-d%g%s",
+             shape.dims.width,
+             shape.dims.height,
+             type_name(c.type),
+             c.buffers,
+             c.delay_us,
+             mode == EGrabberAcquisition_Callback ? "-callback" : "");
+    *out = {
+        .name = name,
+        .width = shape.dims.width,
+        .height = shape.dims.height,
+        .frames = latencies_us.size(),
+        .seconds = seconds,
+        .mb_per_s = 1e-6 * (double)bytes / seconds,
+        .frames_per_s = (double)latencies_us.size() / seconds,
+        .p50_us = percentile(latencies_us, 0.5),
+        .p99_us = percentile(latencies_us, 0.99),
+        .p999_us = percentile(latencies_us, 0.999),
+        .max_us = latencies_us.empty() ? 0 : latencies_us.back(),
+        .queue_overflows = after.queue_overflows - before.queue_overflows,
+        .frames_lost = after.frames_lost - before.frames_lost,
+        // Since start, so including the warm up.
+        .jitter_mean_us = after.receive_jitter_mean_us,
+        .jitter_max_us = after.receive_jitter_max_us,
+        .run_queue_wait_ms = after.run_queue_wait_ms,
+        .realtime = after.realtime != 0,
+        .data_streams = after.data_streams,
+    };
+    return ok;
+}
+
+/// Fires software triggers one at a time, waiting for each frame, and reads
+/// the driver's trigger to frame latency.
+bool
+run_triggers(struct Camera* camera,
+             const Api& api,
+             const Options& opts,
+             enum EGrabberAcquisitionMode mode,
+             TriggerResult* out)
+{
+    struct CameraProperties props = {};
+    if (camera->get(camera, &props) != Device_Ok)
+        return false;
+    props.pixel_type = SampleType_u8;
+    props.exposure_time_us = opts.exposure_us;
+    props.input_triggers.frame_start = {
+        .enable = 1,
+        .line = 1, // Software
+        .kind = Signal_Input,
+        .edge = TriggerEdge_Rising,
+    };
+    if (camera->set(camera, &props) != Device_Ok)
+        return false;
+
+    struct ImageShape shape = {};
+    if (camera->get_shape(camera, &shape) != Device_Ok)
+        return false;
+    std::vector<uint8_t> im((size_t)shape.dims.width * shape.dims.height * 2);
+
+    if (camera->start(camera) != Device_Ok)
+        return false;
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < opts.triggers; ++i) {
+        struct ImageInfo info = {};
+        size_t nbytes = im.size();
+        ok = camera->execute_trigger(camera) == Device_Ok &&
+             api.try_get_frame(camera, im.data(), &nbytes, &info, 1000) ==
+               EGrabberFrame_Ok;
+    }
+    struct EGrabberStats stats = {};
+    api.get_stats(camera, &stats);
+    ok = camera->stop(camera) == Device_Ok && ok;
+
+    props.input_triggers.frame_start.enable = 0;
+    ok = camera->set(camera, &props) == Device_Ok && ok;
+
+    *out = {
+        .mode = mode,
+        .frames = stats.triggered_frames,
+        .mean_us = stats.trigger_latency_mean_us,
+        .max_us = stats.trigger_latency_max_us,
+    };
+    return ok;
+}
+
+std::string
+to_json_line(const Result& r)
+{
+    char buf[1024];
+    snprintf(buf,
+             sizeof(buf),
+             "{\"name\": \"%s\", \"width\": %u, \"height\": %u, "
+             "\"frames\": %llu, \"seconds\": %.3f, \"mb_per_s\": %.3f, "
+             "\"frames_per_s\": %.3f, \"latency_us\": {\"p50\": %.3f, "
+             "\"p99\": %.3f, \"p99.9\": %.3f, \"max\": %.3f}, "
+             "\"queue_overflows\": %llu, \"frames_lost\": %llu, "
+             "\"receive_jitter_us\": {\"mean\": %.3f, \"max\": %.3f}, "
+             "\"run_queue_wait_ms\": %.3f, \"realtime\": %s, "
+             "\"data_streams\": %u}",
+             r.name.c_str(),
+             r.width,
+             r.height,
+             (unsigned long long)r.frames,
+             r.seconds,
+             r.mb_per_s,
+             r.frames_per_s,
+             r.p50_us,
+             r.p99_us,
+             r.p999_us,
+             r.max_us,
+             (unsigned long long)r.queue_overflows,
+             (unsigned long long)r.frames_lost,
+             r.jitter_mean_us,
+             r.jitter_max_us,
+             r.run_queue_wait_ms,
+             r.realtime ? "true" : "false",
+             r.data_streams);
+    return buf;
+}
+
+std::string
+to_json_line(const TriggerResult& r)
+{
+    char buf[256];
+    snprintf(buf,
+             sizeof(buf),
+             "{\"mode\": \"%s\", \"frames\": %llu, \"mean_us\": %.3f, "
+             "\"max_us\": %.3f}",
+             mode_name(r.mode),
+             (unsigned long long)r.frames,
+             r.mean_us,
+             r.max_us);
+    return buf;
+}
+
+/// Finds `"key": <number>` in a line written by to_json_line().
+bool
+json_number(const std::string& line, const char* key, double* out)
+{
+    const std::string needle = std::string("\"") + key + "\": ";
+    const auto i = line.find(needle);
+    if (i == std::string::npos)
+        return false;
+    *out = std::atof(line.c_str() + i + needle.size());
+    return true;
+}
+
+struct BaselineCase
+{
+    double frames_per_s;
+    double p99_us;
+    double dropped;
+};
+
+/// Reads a file written with --json. Only understands this program's own
+/// output: one case per line.
+std::map<std::string, BaselineCase>
+read_baseline(const std::string& path)
+{
+    std::map<std::string, BaselineCase> out;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        const std::string key = "\"name\": \"";
+        const auto i = line.find(key);
+        if (i == std::string::npos)
+            continue;
+        const auto j = line.find('"', i + key.size());
+        BaselineCase b = {};
+        double overflows = 0, lost = 0;
+        json_number(line, "frames_per_s", &b.frames_per_s);
+        json_number(line, "p99", &b.p99_us);
+        json_number(line, "queue_overflows", &overflows);
+        json_number(line, "frames_lost", &lost);
+        b.dropped = overflows + lost;
+        out[line.substr(i + key.size(), j - i - key.size())] = b;
+    }
+    return out;
+}
+
+void
+usage(const char* argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --sizes N,...        square frame sizes in pixels\n"
+            "  --types T,...        pixel types: u8 u10 u12 u14 u16\n"
+            "  --buffers N,...      announced buffer counts\n"
+            "  --delays-us D,...    consumer delay after each frame\n"
+            "  --seconds S          measurement time per case\n"
+            "  --exposure-us E      exposure time\n"
+            "  --modes M,...        acquisition modes: pop callback\n"
+            "  --triggers N         software triggers per mode (0 to skip)\n"
+            "  --priority N         real-time priority of the receiving "
+            "thread\n"
+            "  --json FILE          write the results as JSON\n"
+            "  --baseline FILE      compare against an earlier --json file\n"
+            "  --tolerance F        allowed frame rate loss (default 0.1)\n",
+            argv0);
+}
+
+} // end anonymous namespace
+
+int
+main(int argc, char* argv[])
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+        const auto to_u32 = [](const std::string& s) {
+            return (uint32_t)std::atof(s.c_str());
+        };
+        const auto to_double = [](const std::string& s) {
+            return std::atof(s.c_str());
+        };
+        if (a == "--sizes") {
+            opts.sizes = parse_list<uint32_t>(v, to_u32);
+        } else if (a == "--types") {
+            opts.types.clear();
+            for (const auto& s :
+                 parse_list<std::string>(v, [](const auto& s) { return s; })) {
+                SampleType t;
+                if (!parse_type(s, &t)) {
+                    fprintf(stderr, "Unknown pixel type: %s\n", s.c_str());
+                    return 2;
+                }
+                opts.types.push_back(t);
+            }
+        } else if (a == "--buffers") {
+            opts.buffers = parse_list<uint32_t>(v, to_u32);
+        } else if (a == "--delays-us") {
+            opts.delays_us = parse_list<double>(v, to_double);
+        } else if (a == "--seconds") {
+            opts.seconds = std::atof(v);
+        } else if (a == "--exposure-us") {
+            opts.exposure_us = (float)std::atof(v);
+        } else if (a == "--modes") {
+            opts.modes.clear();
+            for (const auto& s :
+                 parse_list<std::string>(v, [](const auto& s) { return s; })) {
+                enum EGrabberAcquisitionMode m;
+                if (!parse_mode(s, &m)) {
+                    fprintf(
+                      stderr, "Unknown acquisition mode: %s\n", s.c_str());
+                    return 2;
+                }
+                opts.modes.push_back(m);
+            }
+        } else if (a == "--triggers") {
+            opts.triggers = to_u32(v);
+        } else if (a == "--priority") {
+            opts.priority = (int32_t)std::atoi(v);
+        } else if (a == "--json") {
+            opts.json_path = v;
+        } else if (a == "--baseline") {
+            opts.baseline_path = v;
+        } else if (a == "--tolerance") {
+            opts.tolerance = std::atof(v);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    logger_set_reporter(reporter);
+    lib lib{};
+    if (!lib_open_by_name(&lib, "acquire-driver-egrabber")) {
+        fprintf(stderr, "Couldn't load acquire-driver-egrabber\n");
+        return 1;
+    }
+    auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+    const Api api = {
+        .set_buffer_policy = (egrabber_camera_set_buffer_policy_t)lib_load(
+          &lib, "egrabber_camera_set_buffer_policy"),
+        .get_buffer_policy = (egrabber_camera_get_buffer_policy_t)lib_load(
+          &lib, "egrabber_camera_get_buffer_policy"),
+        .get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats"),
+        .try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame"),
+        .set_acquisition_mode =
+          (egrabber_driver_set_acquisition_mode_t)lib_load(
+            &lib, "egrabber_driver_set_acquisition_mode"),
+        .set_thread_priority =
+          (egrabber_camera_set_thread_priority_t)lib_load(
+            &lib, "egrabber_camera_set_thread_priority"),
+    };
+    struct Driver* driver = init ? init(reporter) : nullptr;
+    if (!driver || !api.set_buffer_policy || !api.get_buffer_policy ||
+        !api.get_stats || !api.try_get_frame || !api.set_acquisition_mode ||
+        !api.set_thread_priority || !driver->device_count(driver)) {
+        fprintf(stderr, "Couldn't find a camera\n");
+        if (driver)
+            driver->shutdown(driver);
+        lib_close(&lib);
+        return 1;
+    }
+
+    std::vector<Result> results;
+    std::vector<TriggerResult> trigger_results;
+    printf("%-37s %10s %10s %10s %10s %10s %10s %9s %9s %10s %10s\n",
+           "case",
+           "MB/s",
+           "frames/s",
+           "p50 us",
+           "p99 us",
+           "p99.9 us",
+           "max us",
+           "overflow",
+           "lost",
+           "jitter us",
+           "runq ms");
+    int failures = 0;
+    for (auto mode : opts.modes) {
+        // The mode applies to cameras opened after it's set.
+        struct Device* device = nullptr;
+        if (api.set_acquisition_mode(driver, mode) != Device_Ok ||
+            driver->open(driver, 0, &device) != Device_Ok) {
+            fprintf(stderr, "Couldn't open a camera (%s)\n", mode_name(mode));
+            ++failures;
+            continue;
+        }
+        auto camera = (struct Camera*)device;
+        if (api.set_thread_priority(camera, opts.priority) != Device_Ok)
+            ++failures;
+
+        for (auto size : opts.sizes) {
+            for (auto type : opts.types) {
+                for (auto buffers : opts.buffers) {
+                    for (auto delay_us : opts.delays_us) {
+                        Result r;
+                        if (!run_case(camera,
+                                      api,
+                                      opts,
+                                      mode,
+                                      { size, type, buffers, delay_us },
+                                      &r)) {
+                            fprintf(stderr,
+                                    "Case %ux%u %s, %u buffers, %g us, %s "
+                                    "failed\n",
+                                    size,
+                                    size,
+                                    type_name(type),
+                                    buffers,
+                                    delay_us,
+                                    mode_name(mode));
+                            ++failures;
+                            continue;
+                        }
+                        printf("%-37s %10.1f %10.1f %10.1f %10.1f %10.1f "
+                               "%10.1f %9llu %9llu %10.1f %10.2f%s\n",
+                               r.name.c_str(),
+                               r.mb_per_s,
+                               r.frames_per_s,
+                               r.p50_us,
+                               r.p99_us,
+                               r.p999_us,
+                               r.max_us,
+                               (unsigned long long)r.queue_overflows,
+                               (unsigned long long)r.frames_lost,
+                               r.jitter_max_us,
+                               r.run_queue_wait_ms,
+                               opts.priority > 0 && !r.realtime
+                                 ? "  (not real-time)"
+                                 : "");
+                        fflush(stdout);
+                        results.push_back(r);
+                    }
+                }
+            }
+        }
+
+        if (opts.triggers) {
+            TriggerResult t;
+            if (run_triggers(camera, api, opts, mode, &t))
+                trigger_results.push_back(t);
+            else
+                ++failures;
+        }
+        driver->close(driver, device);
+    }
+    driver->shutdown(driver);
+    lib_close(&lib);
+
+    if (!trigger_results.empty()) {
+        printf("\n%-10s %10s %10s %10s\n",
+               "trigger",
+               "frames",
+               "mean us",
+               "max us");
+        for (const auto& t : trigger_results)
+            printf("%-10s %10llu %10.1f %10.1f\n",
+                   mode_name(t.mode),
+                   (unsigned long long)t.frames,
+                   t.mean_us,
+                   t.max_us);
+    }
+
+    if (!opts.json_path.empty()) {
+        std::ofstream json(opts.json_path);
+        json << "{\n\"benchmark\": \"frame-path\",\n\"cases\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+            json << to_json_line(results[i])
+                 << (i + 1 < results.size() ? ",\n" : "\n");
+        json << "],\n\"trigger_latency\": [\n";
+        for (size_t i = 0; i < trigger_results.size(); ++i)
+            json << to_json_line(trigger_results[i])
+                 << (i + 1 < trigger_results.size() ? ",\n" : "\n");
+        json << "]\n}\n";
+    }
+
+    int regressions = 0;
+    if (!opts.baseline_path.empty()) {
+        const auto baseline = read_baseline(opts.baseline_path);
+        printf("\n%-37s %12s %12s %8s %12s %12s\n",
+               "vs baseline",
+               "frames/s",
+               "was",
+               "change",
+               "p99 us",
+               "was");
+        for (const auto& r : results) {
+            const auto it = baseline.find(r.name);
+            if (it == baseline.end())
+                continue;
+            const auto& b = it->second;
+            const double change =
+              b.frames_per_s > 0 ? r.frames_per_s / b.frames_per_s - 1 : 0;
+            const bool slower = change < -opts.tolerance;
+            const bool dropping =
+              b.dropped == 0 && r.queue_overflows + r.frames_lost > 0;
+            printf("%-37s %12.1f %12.1f %+7.1f%% %12.1f %12.1f%s\n",
+                   r.name.c_str(),
+                   r.frames_per_s,
+                   b.frames_per_s,
+                   100 * change,
+                   r.p99_us,
+                   b.p99_us,
+                   slower ? "  SLOWER" : dropping ? "  DROPPING" : "");
+            regressions += slower || dropping;
+        }
+        printf("%d regression(s)\n", regressions);
+    }
+    return failures || regressions ? 1 : 0;
+}
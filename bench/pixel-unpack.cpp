@@ -0,0 +1,100 @@
+/// @file
+/// @brief Measures packed pixel unpacking throughput.
+/// Compares the portable unpacker, the vectorized one and the CopyEngine's
+/// worker pool for Mono10p and Mono12p frames. Reports output GB/s, which is
+/// directly comparable with the copy benchmark for 16-bit formats.
+
+#include "src/copy.engine.hh"
+#include "src/pixel.unpack.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+double
+measure_gbps(size_t nbytes, const std::function<void()>& unpack)
+{
+    using clock = std::chrono::steady_clock;
+    const size_t reps = std::max<size_t>(3, (2ULL << 30) / nbytes);
+    unpack(); // warm up: fault in pages, wake workers
+    const auto t0 = clock::now();
+    for (size_t i = 0; i < reps; ++i)
+        unpack();
+    const std::chrono::duration<double> dt = clock::now() - t0;
+    return 1e-9 * (double)(nbytes * reps) / dt.count();
+}
+
+} // end anonymous namespace
+
+int
+main(int argc, char* argv[])
+{
+    // Pixel counts, in megapixels. 151 is the VP-151MX.
+    std::vector<double> sizes = { 1, 4, 16, 64, 151 };
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i)
+            sizes.push_back(std::atof(argv[i]));
+    }
+
+    const size_t max_pixels =
+      (size_t)(1e6 * *std::max_element(sizes.begin(), sizes.end()));
+    std::unique_ptr<uint8_t[]> src(new uint8_t[2 * max_pixels]);
+    std::unique_ptr<uint16_t[]> dst(new uint16_t[max_pixels]);
+    for (size_t i = 0; i < 2 * max_pixels; ++i)
+        src[i] = (uint8_t)(i * 37);
+    std::fill_n(dst.get(), max_pixels, 0);
+
+    const size_t hw = std::thread::hardware_concurrency();
+    std::vector<size_t> thread_counts = { 1, 2, 4 };
+    if (hw > 8)
+        thread_counts.push_back(8);
+
+    const struct
+    {
+        const char* name;
+        PixelPacking packing;
+    } formats[] = {
+        { "Mono10p", PixelPacking::Mono10p },
+        { "Mono12p", PixelPacking::Mono12p },
+    };
+
+    printf("%8s %10s %10s %10s", "format", "size (MP)", "scalar", "simd x1");
+    for (auto n : thread_counts)
+        printf(" %9s%zu", "pool x", n + 1);
+    printf("   (output GB/s)\n");
+
+    for (const auto& format : formats) {
+        for (auto mp : sizes) {
+            const size_t npixels = (size_t)(1e6 * mp);
+            const size_t nbytes = 2 * npixels;
+            printf("%8s %10.2f", format.name, mp);
+            printf(" %10.2f", measure_gbps(nbytes, [&] {
+                       unpack_pixels_scalar(
+                         format.packing, dst.get(), src.get(), npixels);
+                   }));
+            printf(" %10.2f", measure_gbps(nbytes, [&] {
+                       unpack_pixels(
+                         format.packing, dst.get(), src.get(), npixels);
+                   }));
+            for (auto n : thread_counts) {
+                // A threshold of 0 forces the parallel path.
+                CopyEngine engine(n, 0);
+                printf(" %10.2f", measure_gbps(nbytes, [&] {
+                           engine.unpack(
+                             dst.get(), src.get(), npixels, format.packing);
+                       }));
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -1,16 +1,34 @@
 # Euresys EGrabber library
 # This is a GenICam header-only library
+#
+# With EGRABBER_SIMULATED, the driver is built against the simulated eGrabber
+# in sim/include instead, so it can be tested without a frame grabber.
 
-find_path(euresys_egrabber_include_dir "EGrabber.h"
-    PATH_SUFFIXES "euresys/egrabber/include"
-    DOC "Directory that contains EGrabber.h"
-    NO_CACHE)
+option(EGRABBER_SIMULATED "Build against the simulated eGrabber in sim/" OFF)
 
-if(euresys_egrabber_include_dir)
-    message(STATUS "Euresys EGrabber ${euresys_egrabber_include_dir}")
+if(EGRABBER_SIMULATED)
+    set(euresys_egrabber_include_dir "${CMAKE_CURRENT_LIST_DIR}/../sim/include")
+    message(STATUS "Euresys EGrabber (simulated) ${euresys_egrabber_include_dir}")
+else()
+    find_path(euresys_egrabber_include_dir "EGrabber.h"
+        PATH_SUFFIXES "euresys/egrabber/include"
+        DOC "Directory that contains EGrabber.h"
+        NO_CACHE)
+    if(euresys_egrabber_include_dir)
+        message(STATUS "Euresys EGrabber ${euresys_egrabber_include_dir}")
+    endif()
+endif()
 
+if(euresys_egrabber_include_dir)
     set(tgt egrabber)
     add_library(${tgt} IMPORTED INTERFACE)
     set_target_properties(${tgt} PROPERTIES
         INTERFACE_INCLUDE_DIRECTORIES ${euresys_egrabber_include_dir})
-endif()
\ No newline at end of file
+
+    if(EGRABBER_SIMULATED)
+        find_package(Threads REQUIRED)
+        set_target_properties(${tgt} PROPERTIES
+            INTERFACE_COMPILE_DEFINITIONS ACQUIRE_EGRABBER_SIMULATED
+            INTERFACE_LINK_LIBRARIES Threads::Threads)
+    endif()
+endif()
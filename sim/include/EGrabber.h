@@ -0,0 +1,1264 @@
+/// @file Simulated eGrabber.
+///
+/// Stands in for the Euresys eGrabber SDK's `EGrabber.h` when the driver is
+/// configured with `-DEGRABBER_SIMULATED=ON`, so the driver can be built,
+/// tested and benchmarked on machines without a frame grabber.
+///
+/// Only the part of the eGrabber API the driver uses is implemented:
+/// discovery, GenICam feature access on a model of a Vieworks area scan
+/// camera, and the buffer announce/queue/pop/push cycle of its data streams.
+/// Frames are produced by a thread per started grabber, either free-running
+/// at the camera's frame rate or on triggers. A camera with several data
+/// streams sends its frames to them in turn.
+///
+/// The `ACQUIRE_EGRABBER_SIM_*` environment variables described in the
+/// README tune the simulation. They're read once.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_SIM_EGRABBER_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_SIM_EGRABBER_V0
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define GENTL_INFINITE (0xFFFFFFFFFFFFFFFFULL)
+
+namespace Euresys {
+
+namespace gc {
+typedef int32_t GC_ERROR;
+enum GC_ERROR_LIST
+{
+    GC_ERR_SUCCESS = 0,
+    GC_ERR_ERROR = -1001,
+    GC_ERR_NOT_INITIALIZED = -1002,
+    GC_ERR_NOT_IMPLEMENTED = -1003,
+    GC_ERR_RESOURCE_IN_USE = -1004,
+    GC_ERR_ACCESS_DENIED = -1005,
+    GC_ERR_INVALID_HANDLE = -1006,
+    GC_ERR_INVALID_ID = -1007,
+    GC_ERR_NO_DATA = -1008,
+    GC_ERR_INVALID_PARAMETER = -1009,
+    GC_ERR_IO = -1010,
+    GC_ERR_TIMEOUT = -1011,
+    GC_ERR_ABORT = -1012,
+    GC_ERR_INVALID_BUFFER = -1013,
+    GC_ERR_NOT_AVAILABLE = -1014,
+    GC_ERR_INVALID_ADDRESS = -1015,
+    GC_ERR_BUFFER_TOO_SMALL = -1016,
+    GC_ERR_INVALID_INDEX = -1017,
+    GC_ERR_PARSING_CHUNK_DATA = -1018,
+    GC_ERR_INVALID_VALUE = -1019,
+};
+
+typedef int32_t BUFFER_INFO_CMD;
+enum BUFFER_INFO_CMD_LIST
+{
+    BUFFER_INFO_BASE = 0,
+    BUFFER_INFO_SIZE = 1,
+    BUFFER_INFO_USER_PTR = 2,
+    BUFFER_INFO_TIMESTAMP = 3,
+    BUFFER_INFO_SIZE_FILLED = 9,
+    BUFFER_INFO_FRAMEID = 16,
+    BUFFER_INFO_TIMESTAMP_NS = 29,
+};
+} // namespace gc
+
+namespace ge {
+enum BUFFER_INFO_CUSTOM_CMD_LIST
+{
+    BUFFER_INFO_CUSTOM_PART_SIZE = 1000 + 15,
+    BUFFER_INFO_CUSTOM_NUM_DELIVERED_PARTS = 1000 + 17,
+};
+} // namespace ge
+
+class gentl_error : public std::runtime_error
+{
+  public:
+    gentl_error(gc::GC_ERROR err, const std::string& what)
+      : std::runtime_error(what)
+      , gc_err(err)
+    {
+    }
+
+    const gc::GC_ERROR gc_err;
+};
+
+// GenTL modules. Features of every module live in one namespace in the
+// simulation.
+struct SystemModule
+{};
+struct InterfaceModule
+{};
+struct DeviceModule
+{};
+struct StreamModule
+{};
+struct RemoteModule
+{};
+
+// Callback models. On-demand (pop) is simulated, and so is the new buffer
+// event of the multi-thread model. No other events are.
+struct CallbackOnDemand
+{};
+struct CallbackMultiThread
+{};
+
+/// Feature queries. The real SDK encodes these as feature names too.
+namespace query {
+inline std::string
+available(const std::string& feature)
+{
+    return "?available:" + feature;
+}
+
+inline std::string
+writeable(const std::string& feature)
+{
+    return "?writeable:" + feature;
+}
+
+inline std::string
+info(const std::string& feature, const std::string& what)
+{
+    return "?info:" + feature + ":" + what;
+}
+
+inline std::string
+enumEntries(const std::string& feature)
+{
+    return "?enumEntries:" + feature;
+}
+
+inline std::string
+features()
+{
+    return "?features";
+}
+} // namespace query
+
+struct UserMemory
+{
+    UserMemory(void* base, size_t size)
+      : base(base)
+      , size(size)
+    {
+    }
+
+    void* base;
+    size_t size;
+};
+
+class EGenTL
+{};
+
+/// One data stream of a camera.
+struct EGrabberInfo
+{
+    int interfaceIndex = 0;
+    int deviceIndex = -1; // The simulated camera's index.
+    int streamIndex = 0;
+    bool isRemoteAvailable = true;
+};
+
+struct EGrabberCameraInfo
+{
+    int index = -1;
+    // One per data stream. The first one controls the camera.
+    std::vector<EGrabberInfo> grabbers;
+};
+
+namespace sim {
+
+inline double
+env_or(const char* name, double dflt)
+{
+    const char* v = std::getenv(name);
+    if (!v || !*v)
+        return dflt;
+    char* end = nullptr;
+    const double out = std::strtod(v, &end);
+    return end == v ? dflt : out;
+}
+
+struct Config
+{
+    int cameras;
+    int64_t sensor_width, sensor_height;
+    double frame_rate_hz;
+    double feature_latency_us;
+    double discovery_ms;
+    uint64_t drop_every;
+    bool fill;
+    double line0_hz;
+    int streams;
+};
+
+inline const Config&
+config()
+{
+    static const Config c = {
+        .cameras = (int)env_or("ACQUIRE_EGRABBER_SIM_CAMERAS", 1),
+        .sensor_width =
+          (int64_t)env_or("ACQUIRE_EGRABBER_SIM_SENSOR_WIDTH", 2048),
+        .sensor_height =
+          (int64_t)env_or("ACQUIRE_EGRABBER_SIM_SENSOR_HEIGHT", 2048),
+        .frame_rate_hz = env_or("ACQUIRE_EGRABBER_SIM_FPS", 100),
+        .feature_latency_us =
+          env_or("ACQUIRE_EGRABBER_SIM_FEATURE_LATENCY_US", 100),
+        .discovery_ms = env_or("ACQUIRE_EGRABBER_SIM_DISCOVERY_MS", 20),
+        .drop_every = (uint64_t)env_or("ACQUIRE_EGRABBER_SIM_DROP_EVERY", 0),
+        .fill = env_or("ACQUIRE_EGRABBER_SIM_FILL", 0) != 0,
+        .line0_hz = env_or("ACQUIRE_EGRABBER_SIM_LINE0_HZ", 0),
+        .streams =
+          std::max((int)env_or("ACQUIRE_EGRABBER_SIM_STREAMS", 1), 1),
+    };
+    return c;
+}
+
+inline uint64_t
+now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// One round trip over the camera's control link.
+inline void
+control_link_delay()
+{
+    const double us = config().feature_latency_us;
+    if (us > 0)
+        std::this_thread::sleep_for(
+          std::chrono::duration<double, std::micro>(us));
+}
+
+[[noreturn]] inline void
+fail(gc::GC_ERROR err, const std::string& what)
+{
+    throw gentl_error(err, what);
+}
+
+/// Bits per pixel of the pixel formats the camera model supports.
+inline size_t
+bits_per_pixel(const std::string& format)
+{
+    if (format == "Mono8")
+        return 8;
+    if (format == "Mono10p")
+        return 10;
+    if (format == "Mono12p")
+        return 12;
+    return 16; // Mono10, Mono12, Mono14, Mono16
+}
+
+/// What a grabber needs to know about the camera to produce frames.
+struct StreamSettings
+{
+    size_t image_bytes;
+    size_t part_count;
+    std::chrono::nanoseconds frame_period;
+    bool triggered;
+    bool software_trigger;
+};
+
+/// The camera's state. Shared by every grabber opened on it and kept for
+/// the life of the process, like the settings of a real camera.
+class Device
+{
+  public:
+    explicit Device(int index)
+      : index_(index)
+      , width_(config().sensor_width)
+      , height_(config().sensor_height)
+      , offset_x_(0)
+      , offset_y_(0)
+      , binning_h_(1)
+      , binning_v_(1)
+      , part_count_(1)
+      , black_level_(0)
+      , exposure_us_(1000)
+      , gain_db_(0)
+      , frame_rate_hz_(config().frame_rate_hz)
+      , pixel_format_("Mono8")
+      , trigger_mode_("Off")
+      , trigger_source_("Line0")
+      , trigger_activation_("RisingEdge")
+    {
+    }
+
+    int64_t get_integer(const std::string& name)
+    {
+        control_link_delay();
+        const std::scoped_lock lock(lock_);
+        if (const auto f = strip_(name, "?available:"))
+            return is_feature_(*f);
+        if (const auto f = strip_(name, "?writeable:"))
+            return is_writeable_(*f);
+
+        const int64_t w = max_width_(), h = max_height_();
+        const std::map<std::string, int64_t> v = {
+            { "Width", width_ },
+            { "Height", height_ },
+            { "OffsetX", offset_x_ },
+            { "OffsetY", offset_y_ },
+            { "WidthMinReg", 16 },
+            { "WidthMaxReg", w - offset_x_ },
+            { "HeightMinReg", 16 },
+            { "HeightMaxReg", h - offset_y_ },
+            { "OffsetXMinReg", 0 },
+            { "OffsetXMaxReg", w - width_ },
+            { "OffsetYMinReg", 0 },
+            { "OffsetYMaxReg", h - height_ },
+            { "WidthMax", w },
+            { "HeightMax", h },
+            { "SensorWidth", config().sensor_width },
+            { "SensorHeight", config().sensor_height },
+            { "BinningHorizontal", binning_h_ },
+            { "BinningVertical", binning_v_ },
+            { "BufferPartCount", part_count_ },
+            { "BlackLevel", black_level_ },
+            { "PixelSize", (int64_t)bits_per_pixel(pixel_format_) },
+            { "PayloadSize", (int64_t)payload_bytes_() },
+        };
+        const auto it = v.find(name);
+        if (it == v.end())
+            fail(gc::GC_ERR_INVALID_ID, "No integer feature " + name);
+        return it->second;
+    }
+
+    double get_float(const std::string& name)
+    {
+        control_link_delay();
+        const std::scoped_lock lock(lock_);
+        if (name == "ExposureTime")
+            return exposure_us_;
+        if (name == "ExposureTimeMinReg")
+            return min_exposure_us;
+        if (name == "ExposureTimeMaxReg")
+            return max_exposure_us;
+        if (name == "AcquisitionFrameRate")
+            return 1e9 / (double)frame_period_().count();
+        if (name == "Gain")
+            return gain_db_;
+        if (name == "DeviceTemperature")
+            return 41.5;
+        fail(gc::GC_ERR_INVALID_ID, "No float feature " + name);
+    }
+
+    std::string get_string(const std::string& name)
+    {
+        control_link_delay();
+        const std::scoped_lock lock(lock_);
+        if (name == query::info("ExposureTime", "Unit"))
+            return "us";
+        const std::map<std::string, std::string> v = {
+            { "PixelFormat", pixel_format_ },
+            { "TriggerMode", trigger_mode_ },
+            { "TriggerSource", trigger_source_ },
+            { "TriggerActivation", trigger_activation_ },
+            { "TriggerSelector", "ExposureStart" },
+            { "DeviceVendorName", "VIEWORKS" },
+            { "DeviceModelName", "VC-151MX-M6H00 (simulated)" },
+            { "DeviceSerialNumber", "SIM" + std::to_string(index_) },
+            { "DeviceID", "Device" + std::to_string(index_) },
+            { "InterfaceID", "SimulatedInterface" },
+        };
+        const auto it = v.find(name);
+        if (it == v.end())
+            fail(gc::GC_ERR_INVALID_ID, "No string feature " + name);
+        return it->second;
+    }
+
+    std::vector<std::string> get_string_list(const std::string& name)
+    {
+        control_link_delay();
+        if (name == query::features()) {
+            return { "Width",
+                     "Height",
+                     "OffsetX",
+                     "OffsetY",
+                     "BinningHorizontal",
+                     "BinningVertical",
+                     "PixelFormat",
+                     "ExposureTime",
+                     "AcquisitionFrameRate",
+                     "Gain",
+                     "BlackLevel",
+                     "DeviceTemperature",
+                     "TriggerMode",
+                     "TriggerSource",
+                     "TriggerActivation" };
+        }
+        const auto f = strip_(name, "?enumEntries:");
+        if (!f)
+            fail(gc::GC_ERR_INVALID_ID, "No string list " + name);
+        const auto entries = enum_entries_(*f);
+        if (entries.empty())
+            fail(gc::GC_ERR_INVALID_ID, "No enumeration " + *f);
+        return entries;
+    }
+
+    void set_integer(const std::string& name, int64_t value)
+    {
+        control_link_delay();
+        const std::scoped_lock lock(lock_);
+        const int64_t w = max_width_(), h = max_height_();
+        if (name == "Width") {
+            check_(name, value, 16, w - offset_x_);
+            width_ = value;
+        } else if (name == "Height") {
+            check_(name, value, 16, h - offset_y_);
+            height_ = value;
+        } else if (name == "OffsetX") {
+            check_(name, value, 0, w - width_);
+            offset_x_ = value;
+        } else if (name == "OffsetY") {
+            check_(name, value, 0, h - height_);
+            offset_y_ = value;
+        } else if (name == "BinningHorizontal" || name == "BinningVertical") {
+            if (value != 1 && value != 2 && value != 4)
+                fail(gc::GC_ERR_INVALID_VALUE,
+                     "Invalid " + name + ": " + std::to_string(value));
+            (name == "BinningHorizontal" ? binning_h_ : binning_v_) = value;
+            // The ROI shrinks to fit the binned sensor.
+            offset_x_ = std::min(offset_x_, max_width_() - 16);
+            width_ = std::min(width_, max_width_() - offset_x_);
+            offset_y_ = std::min(offset_y_, max_height_() - 16);
+            height_ = std::min(height_, max_height_() - offset_y_);
+        } else if (name == "BufferPartCount") {
+            check_(name, value, 1, 1 << 16);
+            part_count_ = value;
+        } else if (name == "BlackLevel") {
+            check_(name, value, 0, 255);
+            black_level_ = value;
+        } else {
+            fail(gc::GC_ERR_ACCESS_DENIED, name + " is not writeable");
+        }
+    }
+
+    void set_float(const std::string& name, double value)
+    {
+        control_link_delay();
+        const std::scoped_lock lock(lock_);
+        if (name == "ExposureTime") {
+            if (value < min_exposure_us || value > max_exposure_us)
+                fail(gc::GC_ERR_INVALID_VALUE,
+                     "ExposureTime out of range: " + std::to_string(value));
+            // The camera works in whole microseconds.
+            exposure_us_ = std::round(value);
+        } else if (name == "AcquisitionFrameRate") {
+            if (value <= 0)
+                fail(gc::GC_ERR_INVALID_VALUE,
+                     "AcquisitionFrameRate must be positive");
+            frame_rate_hz_ = value;
+        } else if (name == "Gain") {
+            if (value < 0 || value > 24)
+                fail(gc::GC_ERR_INVALID_VALUE,
+                     "Gain out of range: " + std::to_string(value));
+            gain_db_ = value;
+        } else {
+            fail(gc::GC_ERR_ACCESS_DENIED, name + " is not writeable");
+        }
+    }
+
+    void set_string(const std::string& name, const std::string& value)
+    {
+        control_link_delay();
+        const std::scoped_lock lock(lock_);
+        const auto entries = enum_entries_(name);
+        if (entries.empty())
+            fail(gc::GC_ERR_ACCESS_DENIED, name + " is not writeable");
+        if (std::find(entries.begin(), entries.end(), value) == entries.end())
+            fail(gc::GC_ERR_INVALID_VALUE,
+                 "Invalid " + name + ": " + value);
+        if (name == "PixelFormat")
+            pixel_format_ = value;
+        else if (name == "TriggerMode")
+            trigger_mode_ = value;
+        else if (name == "TriggerSource")
+            trigger_source_ = value;
+        else if (name == "TriggerActivation")
+            trigger_activation_ = value;
+        else
+            fail(gc::GC_ERR_ACCESS_DENIED, name + " is not writeable");
+    }
+
+    /// Commands other than TriggerSoftware, which the grabber handles.
+    void execute(const std::string& name)
+    {
+        control_link_delay();
+        if (name != "AcquisitionStart" && name != "AcquisitionStop" &&
+            name != "TriggerSoftware")
+            fail(gc::GC_ERR_INVALID_ID, "No command " + name);
+    }
+
+    size_t payload_bytes()
+    {
+        const std::scoped_lock lock(lock_);
+        return payload_bytes_();
+    }
+
+    /// Called when the grabber controlling the camera starts. Triggers are
+    /// counted from there.
+    void start_acquisition()
+    {
+        const std::scoped_lock lock(lock_);
+        triggers_ = 0;
+    }
+
+    /// Counts a software trigger. Returns the data stream its frame goes to.
+    int route_trigger()
+    {
+        const std::scoped_lock lock(lock_);
+        return (int)(triggers_++ % (uint64_t)config().streams);
+    }
+
+    StreamSettings stream_settings()
+    {
+        const std::scoped_lock lock(lock_);
+        return {
+            .image_bytes = image_bytes_(),
+            .part_count = (size_t)part_count_,
+            .frame_period = frame_period_(),
+            .triggered = trigger_mode_ == "On",
+            .software_trigger = trigger_source_ == "Software",
+        };
+    }
+
+    int index() const { return index_; }
+
+    static constexpr double min_exposure_us = 10;
+    static constexpr double max_exposure_us = 10e6;
+
+  private:
+    std::mutex lock_;
+    const int index_;
+    int64_t width_, height_, offset_x_, offset_y_;
+    int64_t binning_h_, binning_v_;
+    int64_t part_count_;
+    int64_t black_level_;
+    double exposure_us_;
+    double gain_db_;
+    double frame_rate_hz_;
+    std::string pixel_format_;
+    std::string trigger_mode_, trigger_source_, trigger_activation_;
+    uint64_t triggers_ = 0;
+
+    static std::optional<std::string> strip_(const std::string& name,
+                                             const char* prefix)
+    {
+        const size_t n = std::strlen(prefix);
+        if (name.compare(0, n, prefix) != 0)
+            return std::nullopt;
+        return name.substr(n);
+    }
+
+    static std::vector<std::string> enum_entries_(const std::string& name)
+    {
+        if (name == "PixelFormat")
+            return { "Mono8",  "Mono10",  "Mono12", "Mono14",
+                     "Mono16", "Mono10p", "Mono12p" };
+        if (name == "TriggerMode")
+            return { "Off", "On" };
+        if (name == "TriggerSource")
+            return { "Line0", "Software" };
+        if (name == "TriggerActivation")
+            return { "RisingEdge", "FallingEdge" };
+        if (name == "BinningHorizontal" || name == "BinningVertical")
+            return { "X1", "X2", "X4" };
+        return {};
+    }
+
+    bool is_writeable_(const std::string& name) const
+    {
+        return name == "Width" || name == "Height" || name == "OffsetX" ||
+               name == "OffsetY" || name == "BinningHorizontal" ||
+               name == "BinningVertical" || name == "BufferPartCount" ||
+               name == "ExposureTime" || name == "AcquisitionFrameRate" ||
+               name == "Gain" || name == "BlackLevel" ||
+               !enum_entries_(name).empty();
+    }
+
+    bool is_feature_(const std::string& name) const
+    {
+        return is_writeable_(name) || name == "PayloadSize" ||
+               name == "PixelSize" || name == "TriggerSoftware" ||
+               name == "DeviceTemperature" || name == "DeviceVendorName" ||
+               name == "DeviceModelName" || name == "DeviceSerialNumber";
+    }
+
+    static void check_(const std::string& name,
+                       int64_t value,
+                       int64_t lo,
+                       int64_t hi)
+    {
+        if (value < lo || value > hi)
+            fail(gc::GC_ERR_INVALID_VALUE,
+                 name + " out of range [" + std::to_string(lo) + ", " +
+                   std::to_string(hi) + "]: " + std::to_string(value));
+    }
+
+    int64_t max_width_() const { return config().sensor_width / binning_h_; }
+    int64_t max_height_() const
+    {
+        return config().sensor_height / binning_v_;
+    }
+
+    size_t image_bytes_() const
+    {
+        const size_t bits =
+          (size_t)(width_ * height_) * bits_per_pixel(pixel_format_);
+        return (bits + 7) / 8;
+    }
+
+    size_t payload_bytes_() const { return image_bytes_() * part_count_; }
+
+    std::chrono::nanoseconds frame_period_() const
+    {
+        // Exposures longer than the frame period slow the camera down.
+        const double s = std::max(1.0 / frame_rate_hz_, 1e-6 * exposure_us_);
+        return std::chrono::nanoseconds((int64_t)(s * 1e9));
+    }
+};
+
+/// Simulated cameras, by discovery index.
+inline Device&
+device(int index)
+{
+    static std::mutex lock;
+    static std::map<int, std::unique_ptr<Device>> devices;
+    const std::scoped_lock guard(lock);
+    auto& d = devices[index];
+    if (!d)
+        d = std::make_unique<Device>(index);
+    return *d;
+}
+
+} // namespace sim
+
+class EGrabberDiscovery
+{
+  public:
+    explicit EGrabberDiscovery(EGenTL&) {}
+
+    void discover()
+    {
+        const double ms = sim::config().discovery_ms;
+        if (ms > 0)
+            std::this_thread::sleep_for(
+              std::chrono::duration<double, std::milli>(ms));
+        count_ = std::max(sim::config().cameras, 0);
+    }
+
+    int cameraCount() const { return count_; }
+
+    EGrabberCameraInfo cameras(int index) const
+    {
+        if (index < 0 || index >= count_)
+            sim::fail(gc::GC_ERR_INVALID_INDEX,
+                      "No camera " + std::to_string(index));
+        EGrabberCameraInfo info = { .index = index };
+        for (int s = 0; s < sim::config().streams; ++s)
+            info.grabbers.push_back({ .deviceIndex = index, .streamIndex = s });
+        return info;
+    }
+
+  private:
+    int count_ = 0;
+};
+
+/// A filled buffer, as returned by `EGrabber::pop`.
+struct NewBufferData
+{
+    size_t index;
+    uint64_t generation;
+    void* base;
+    size_t size;
+    uint64_t frame_id;
+    uint64_t timestamp_ns;
+    size_t parts;
+    size_t part_size;
+};
+
+class Buffer;
+
+class EGrabberBase
+{
+  public:
+    EGrabberBase(const EGrabberBase&) = delete;
+    EGrabberBase& operator=(const EGrabberBase&) = delete;
+
+    virtual ~EGrabberBase()
+    {
+        {
+            const std::scoped_lock lock(registry_lock_());
+            auto& r = registry_();
+            r.erase(std::find(r.begin(), r.end(), this));
+        }
+        try {
+            stop();
+        } catch (...) {
+        }
+    }
+
+    template<typename M>
+    int64_t getInteger(const std::string& name)
+    {
+        return device_.get_integer(name);
+    }
+
+    template<typename M>
+    double getFloat(const std::string& name)
+    {
+        return device_.get_float(name);
+    }
+
+    template<typename M>
+    std::string getString(const std::string& name)
+    {
+        return device_.get_string(name);
+    }
+
+    template<typename M>
+    std::vector<std::string> getStringList(const std::string& name)
+    {
+        return device_.get_string_list(name);
+    }
+
+    template<typename M>
+    void setInteger(const std::string& name, int64_t value)
+    {
+        require_idle_for_(name);
+        device_.set_integer(name, value);
+    }
+
+    template<typename M>
+    void setFloat(const std::string& name, double value)
+    {
+        device_.set_float(name, value);
+    }
+
+    template<typename M>
+    void setString(const std::string& name, const std::string& value)
+    {
+        require_idle_for_(name);
+        device_.set_string(name, value);
+    }
+
+    template<typename M>
+    void execute(const std::string& name)
+    {
+        device_.execute(name);
+        if (name == "TriggerSoftware") {
+            // The camera sends the frame to one of its data streams, which
+            // may be open in another grabber.
+            const int stream = device_.route_trigger();
+            const std::scoped_lock registry(registry_lock_());
+            for (auto* g : registry_()) {
+                if (&g->device_ != &device_ || g->stream_ != stream)
+                    continue;
+                const std::scoped_lock lock(g->lock_);
+                if (g->running_) {
+                    ++g->pending_triggers_;
+                    g->cv_.notify_all();
+                }
+            }
+        }
+    }
+
+    std::string getPixelFormat()
+    {
+        return device_.get_string("PixelFormat");
+    }
+
+    size_t getPayloadSize() { return device_.payload_bytes(); }
+
+    /// Revokes every buffer and announces `count` new ones of the current
+    /// payload size, allocated by the (simulated) GenTL producer.
+    void reallocBuffers(size_t count, size_t size = 0)
+    {
+        const size_t bytes = size ? size : getPayloadSize();
+        const std::scoped_lock lock(lock_);
+        require_stopped_("reallocBuffers");
+        revoke_all_();
+        for (size_t i = 0; i < count; ++i) {
+            auto owned = std::unique_ptr<uint8_t[]>(new uint8_t[bytes]);
+            buffers_.push_back({ .base = owned.get(),
+                                 .size = bytes,
+                                 .owned = std::move(owned),
+                                 .queued = true });
+            input_.push_back(buffers_.size() - 1);
+        }
+    }
+
+    void announceAndQueue(const UserMemory& memory)
+    {
+        const std::scoped_lock lock(lock_);
+        require_stopped_("announceAndQueue");
+        buffers_.push_back({ .base = (uint8_t*)memory.base,
+                             .size = memory.size,
+                             .queued = true });
+        input_.push_back(buffers_.size() - 1);
+    }
+
+    /// Puts every announced buffer back in the input queue.
+    void resetBufferQueue()
+    {
+        const std::scoped_lock lock(lock_);
+        require_stopped_("resetBufferQueue");
+        input_.clear();
+        output_.clear();
+        filling_.reset();
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            buffers_[i].queued = true;
+            input_.push_back(i);
+        }
+    }
+
+    void start(uint64_t frame_count = GENTL_INFINITE,
+               bool control_remote_device = true)
+    {
+        (void)frame_count;
+        if (control_remote_device)
+            device_.start_acquisition();
+        {
+            const std::scoped_lock lock(lock_);
+            if (running_)
+                sim::fail(gc::GC_ERR_RESOURCE_IN_USE, "Already started");
+            if (buffers_.empty())
+                sim::fail(gc::GC_ERR_NO_DATA, "No buffers announced");
+            const auto s = device_.stream_settings();
+            if (buffers_.front().size < s.image_bytes * s.part_count)
+                sim::fail(gc::GC_ERR_BUFFER_TOO_SMALL,
+                          "Buffers are smaller than the payload");
+            running_ = true;
+            cancelled_ = false;
+            pending_triggers_ = 0;
+        }
+        producer_ = std::thread([this] { produce_(); });
+        if (callbacks_)
+            dispatcher_ = std::thread([this] { dispatch_(); });
+    }
+
+    void stop()
+    {
+        {
+            const std::scoped_lock lock(lock_);
+            running_ = false;
+            cv_.notify_all();
+        }
+        if (producer_.joinable())
+            producer_.join();
+        if (dispatcher_.joinable())
+            dispatcher_.join();
+
+        // A partly filled buffer goes back to the input queue.
+        const std::scoped_lock lock(lock_);
+        if (filling_ && filling_->index) {
+            buffers_[*filling_->index].queued = true;
+            input_.push_front(*filling_->index);
+        }
+        filling_.reset();
+    }
+
+    /// Waits for the next filled buffer. Throws a `gentl_error` with
+    /// `GC_ERR_TIMEOUT` after `timeout_ms`, or `GC_ERR_ABORT` if
+    /// `cancelPop()` was called.
+    NewBufferData pop(uint64_t timeout_ms = GENTL_INFINITE)
+    {
+        if (callbacks_)
+            sim::fail(gc::GC_ERR_NOT_AVAILABLE,
+                      "Buffers are delivered to onNewBufferEvent");
+        std::unique_lock<std::mutex> lock(lock_);
+        const auto ready = [this] { return !output_.empty() || cancelled_; };
+        if (timeout_ms == GENTL_INFINITE) {
+            cv_.wait(lock, ready);
+        } else if (!cv_.wait_for(
+                     lock, std::chrono::milliseconds(timeout_ms), ready)) {
+            sim::fail(gc::GC_ERR_TIMEOUT, "Timed out waiting for a buffer");
+        }
+        if (cancelled_) {
+            cancelled_ = false;
+            sim::fail(gc::GC_ERR_ABORT, "pop was cancelled");
+        }
+        const auto out = output_.front();
+        output_.pop_front();
+        return out;
+    }
+
+    /// Makes a pending (or the next) `pop()` fail with `GC_ERR_ABORT`.
+    void cancelPop()
+    {
+        const std::scoped_lock lock(lock_);
+        cancelled_ = true;
+        cv_.notify_all();
+    }
+
+    /// Stops the callback thread. Grabbers derived from a callback model
+    /// must call this in their destructor, before their members are gone.
+    void shutdown() { stop(); }
+
+  protected:
+    /// With `callbacks`, filled buffers are handed to `onNewBufferEvent`
+    /// on a dedicated thread, one at a time, instead of being popped.
+    EGrabberBase(const EGrabberInfo& info, bool callbacks)
+      : callbacks_(callbacks)
+      , device_(sim::device(std::max(info.deviceIndex, 0)))
+      , stream_(info.streamIndex)
+      , generation_(0)
+      , next_buffer_id_(0)
+      , next_image_(0)
+      , pending_triggers_(0)
+      , running_(false)
+      , cancelled_(false)
+    {
+        if (info.deviceIndex < 0 || info.deviceIndex >= sim::config().cameras)
+            sim::fail(gc::GC_ERR_INVALID_INDEX, "No such camera");
+        if (stream_ < 0 || stream_ >= sim::config().streams)
+            sim::fail(gc::GC_ERR_INVALID_INDEX, "No such data stream");
+        const std::scoped_lock lock(registry_lock_());
+        registry_().push_back(this);
+    }
+
+    virtual void onNewBufferEvent(const NewBufferData&) {}
+
+  private:
+    friend class Buffer;
+
+    struct SimBuffer
+    {
+        uint8_t* base;
+        size_t size;
+        std::unique_ptr<uint8_t[]> owned;
+        bool queued;
+    };
+
+    // The buffer images are currently written to. `index` is empty when
+    // the buffer is being lost: no buffer was free, or a drop was injected.
+    struct Filling
+    {
+        std::optional<size_t> index;
+        uint64_t id;
+        size_t parts;
+    };
+
+    const bool callbacks_;
+    sim::Device& device_;
+    const int stream_;
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::vector<SimBuffer> buffers_;
+    std::deque<size_t> input_;
+    std::deque<NewBufferData> output_;
+    std::optional<Filling> filling_;
+    uint64_t generation_;
+    uint64_t next_buffer_id_;
+    uint64_t next_image_;
+    uint64_t pending_triggers_;
+    bool running_;
+    bool cancelled_;
+    std::thread producer_;
+    std::thread dispatcher_;
+
+    // Every grabber, so software triggers reach the data stream the camera
+    // sends their frame to.
+    static std::mutex& registry_lock_()
+    {
+        static std::mutex lock;
+        return lock;
+    }
+
+    static std::vector<EGrabberBase*>& registry_()
+    {
+        static std::vector<EGrabberBase*> grabbers;
+        return grabbers;
+    }
+
+    void require_stopped_(const char* what) const
+    {
+        // Locking: Expects lock_ to be held by the caller.
+        if (running_)
+            sim::fail(gc::GC_ERR_RESOURCE_IN_USE,
+                      std::string(what) + " while acquiring");
+    }
+
+    void require_idle_for_(const std::string& name)
+    {
+        // Features that change the payload are locked during acquisition.
+        static const char* locked[] = { "Width",
+                                        "Height",
+                                        "PixelFormat",
+                                        "BinningHorizontal",
+                                        "BinningVertical",
+                                        "BufferPartCount" };
+        const std::scoped_lock lock(lock_);
+        for (const auto* f : locked)
+            if (name == f && running_)
+                sim::fail(gc::GC_ERR_ACCESS_DENIED,
+                          name + " is locked during acquisition");
+    }
+
+    void revoke_all_()
+    {
+        // Locking: Expects lock_ to be held by the caller.
+        buffers_.clear();
+        input_.clear();
+        output_.clear();
+        filling_.reset();
+        ++generation_;
+    }
+
+    void push_(const NewBufferData& data)
+    {
+        const std::scoped_lock lock(lock_);
+        if (data.generation != generation_ || data.index >= buffers_.size())
+            sim::fail(gc::GC_ERR_INVALID_BUFFER, "Buffer was revoked");
+        auto& b = buffers_[data.index];
+        if (b.queued)
+            sim::fail(gc::GC_ERR_RESOURCE_IN_USE, "Buffer is already queued");
+        b.queued = true;
+        input_.push_back(data.index);
+    }
+
+    // Waits until the camera would produce the next image. Returns false
+    // when acquisition stops.
+    bool wait_for_image_(std::chrono::steady_clock::time_point* next)
+    {
+        using namespace std::chrono;
+        std::unique_lock<std::mutex> lock(lock_);
+        while (running_) {
+            // Re-read the trigger settings every few ms so changes made
+            // during acquisition take effect.
+            lock.unlock();
+            const auto s = device_.stream_settings();
+            lock.lock();
+            if (!running_)
+                break;
+            if (s.triggered) {
+                if (s.software_trigger && pending_triggers_) {
+                    --pending_triggers_;
+                    *next = steady_clock::now() + s.frame_period;
+                    return true;
+                }
+                // Line0 is shared by every camera, so triggered cameras
+                // capture together. Not driven unless a rate is set.
+                const double hz = sim::config().line0_hz;
+                if (s.software_trigger || hz <= 0) {
+                    cv_.wait_for(lock, milliseconds(10));
+                    continue;
+                }
+                const auto period = (uint64_t)(1e9 / hz);
+                const uint64_t edge = (sim::now_ns() / period + 1) * period;
+                cv_.wait_until(
+                  lock,
+                  std::min(steady_clock::time_point(nanoseconds(edge)),
+                           steady_clock::now() + milliseconds(10)));
+                // Edges go to the data streams in turn.
+                const auto streams = (uint64_t)sim::config().streams;
+                if (running_ && sim::now_ns() >= edge &&
+                    (edge / period) % streams == (uint64_t)stream_) {
+                    *next = steady_clock::now() + s.frame_period;
+                    return true;
+                }
+                continue;
+            }
+            const auto now = steady_clock::now();
+            if (now >= *next) {
+                // Free-running. Don't try to catch up after a stall. Each
+                // data stream gets every Nth frame.
+                *next = std::max(*next + sim::config().streams * s.frame_period,
+                                 now);
+                return true;
+            }
+            cv_.wait_until(lock, std::min(*next, now + milliseconds(10)));
+        }
+        return false;
+    }
+
+    void produce_()
+    {
+        auto next = std::chrono::steady_clock::now() +
+                    stream_ * device_.stream_settings().frame_period;
+        while (wait_for_image_(&next)) {
+            const auto s = device_.stream_settings();
+            const std::scoped_lock lock(lock_);
+            deliver_image_(s);
+        }
+    }
+
+    void dispatch_()
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        while (true) {
+            cv_.wait(lock, [this] { return !output_.empty() || !running_; });
+            if (!running_)
+                return;
+            const auto data = output_.front();
+            output_.pop_front();
+            lock.unlock();
+            onNewBufferEvent(data);
+            lock.lock();
+        }
+    }
+
+    void deliver_image_(const sim::StreamSettings& s)
+    {
+        // Locking: Expects lock_ to be held by the caller.
+        const uint64_t image = next_image_++;
+        if (!filling_) {
+            filling_ = Filling{ .id = next_buffer_id_++, .parts = 0 };
+            const uint64_t every = sim::config().drop_every;
+            const bool dropped = every && filling_->id % every == every - 1;
+            if (!dropped && !input_.empty()) {
+                filling_->index = input_.front();
+                input_.pop_front();
+                buffers_[*filling_->index].queued = false;
+            }
+        }
+
+        if (filling_->index) {
+            auto& b = buffers_[*filling_->index];
+            uint8_t* dst = b.base + filling_->parts * s.image_bytes;
+            // Only the sequence number is written by default. The real
+            // grabber's DMA costs the host nothing.
+            if (sim::config().fill)
+                std::memset(dst, (int)(image & 0xff), s.image_bytes);
+            std::memcpy(dst, &image, std::min(sizeof(image), s.image_bytes));
+        }
+
+        if (++filling_->parts < s.part_count)
+            return;
+        if (filling_->index) {
+            const auto& b = buffers_[*filling_->index];
+            output_.push_back({
+              .index = *filling_->index,
+              .generation = generation_,
+              .base = b.base,
+              .size = b.size,
+              .frame_id = filling_->id,
+              .timestamp_ns = sim::now_ns(),
+              .parts = filling_->parts,
+              .part_size = s.image_bytes,
+            });
+            cv_.notify_all();
+        }
+        filling_.reset();
+    }
+};
+
+template<typename CallbackModel = CallbackOnDemand>
+class EGrabber : public EGrabberBase
+{
+  public:
+    /// Opens the camera's first data stream.
+    EGrabber(const EGrabberCameraInfo& info)
+      : EGrabberBase({ .deviceIndex = info.index }, is_callback_model)
+    {
+    }
+
+    EGrabber(const EGrabberInfo& info)
+      : EGrabberBase(info, is_callback_model)
+    {
+    }
+
+    /// Opens the first camera.
+    explicit EGrabber(EGenTL&, int = 0, int = 0, int = 0)
+      : EGrabberBase({ .deviceIndex = 0 }, is_callback_model)
+    {
+    }
+
+  private:
+    static constexpr bool is_callback_model =
+      std::is_same_v<CallbackModel, CallbackMultiThread>;
+};
+
+class Buffer
+{
+  public:
+    Buffer(const NewBufferData& data)
+      : data_(data)
+    {
+    }
+
+    /// Gives the buffer back to the grabber's input queue.
+    void push(EGrabberBase& grabber) { grabber.push_(data_); }
+
+    template<typename T>
+    T getInfo(gc::BUFFER_INFO_CMD cmd) const
+    {
+        if constexpr (std::is_pointer_v<T>) {
+            if (cmd == gc::BUFFER_INFO_BASE)
+                return (T)data_.base;
+            if (cmd == gc::BUFFER_INFO_USER_PTR)
+                return (T) nullptr;
+        } else {
+            switch (cmd) {
+                case gc::BUFFER_INFO_SIZE:
+                    return (T)data_.size;
+                case gc::BUFFER_INFO_SIZE_FILLED:
+                    return (T)(data_.parts * data_.part_size);
+                case gc::BUFFER_INFO_FRAMEID:
+                    return (T)data_.frame_id;
+                case gc::BUFFER_INFO_TIMESTAMP:
+                    return (T)(data_.timestamp_ns / 1000);
+                case gc::BUFFER_INFO_TIMESTAMP_NS:
+                    return (T)data_.timestamp_ns;
+                case ge::BUFFER_INFO_CUSTOM_PART_SIZE:
+                    return (T)data_.part_size;
+                case ge::BUFFER_INFO_CUSTOM_NUM_DELIVERED_PARTS:
+                    return (T)data_.parts;
+                default:
+                    break;
+            }
+        }
+        sim::fail(gc::GC_ERR_NOT_AVAILABLE,
+                  "Buffer info " + std::to_string(cmd) +
+                    " isn't simulated");
+    }
+
+  private:
+    NewBufferData data_;
+};
+
+/// Pops a buffer and pushes it back when it goes out of scope.
+class ScopedBuffer : public Buffer
+{
+  public:
+    explicit ScopedBuffer(EGrabberBase& grabber,
+                          uint64_t timeout_ms = GENTL_INFINITE)
+      : Buffer(grabber.pop(timeout_ms))
+      , grabber_(grabber)
+    {
+    }
+
+    ~ScopedBuffer()
+    {
+        try {
+            push(grabber_);
+        } catch (...) {
+        }
+    }
+
+  private:
+    EGrabberBase& grabber_;
+};
+
+} // namespace Euresys
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_SIM_EGRABBER_V0
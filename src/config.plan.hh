@@ -0,0 +1,72 @@
+/// @file Ordering of camera feature writes.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_CONFIG_PLAN_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_CONFIG_PLAN_V0
+
+#include "feature.cache.hh"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// The feature writes needed to take the camera from its current settings
+/// to a target, in an order the camera will accept.
+///
+/// Features already at their target value aren't written. Writes are
+/// collected first and applied together with `FeatureCache::apply()`.
+struct ConfigPlan final
+{
+    void write_if_changed(const std::string& name,
+                          int64_t current,
+                          int64_t target)
+    {
+        if (current != target)
+            writes_.push_back({ name, target });
+    }
+
+    /// Float features are compared at the precision of `CameraProperties`.
+    void write_if_changed(const std::string& name, double current, float target)
+    {
+        if ((float)current != target)
+            writes_.push_back({ name, (double)target });
+    }
+
+    void write_if_changed(const std::string& name,
+                          const std::string& current,
+                          const std::string& target)
+    {
+        if (current != target)
+            writes_.push_back({ name, target });
+    }
+
+    /// Moves one axis of the region of interest. The camera requires
+    /// `offset + size` to stay within the sensor after every write. Both
+    /// the current and the target ROI satisfy that, so it's enough to write
+    /// whichever of offset and size shrinks first. If neither shrinks, the
+    /// offset goes first, since `target offset + current size` is within
+    /// `target offset + target size`.
+    void write_roi_axis(const std::string& offset_name,
+                        const std::string& size_name,
+                        int64_t current_offset,
+                        int64_t current_size,
+                        int64_t target_offset,
+                        int64_t target_size)
+    {
+        const bool size_first =
+          target_size < current_size && target_offset >= current_offset;
+        if (size_first) {
+            write_if_changed(size_name, current_size, target_size);
+            write_if_changed(offset_name, current_offset, target_offset);
+        } else {
+            write_if_changed(offset_name, current_offset, target_offset);
+            write_if_changed(size_name, current_size, target_size);
+        }
+    }
+
+    const std::vector<FeatureWrite>& writes() const { return writes_; }
+    bool empty() const { return writes_.empty(); }
+
+  private:
+    std::vector<FeatureWrite> writes_;
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_CONFIG_PLAN_V0
@@ -0,0 +1,220 @@
+#include "copy.engine.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Chunks handed to workers are multiples of a page so that neighbouring
+// workers don't write to the same page.
+constexpr size_t CHUNK_ALIGNMENT = 4096;
+
+size_t
+round_up(size_t v, size_t multiple)
+{
+    return ((v + multiple - 1) / multiple) * multiple;
+}
+
+void
+copy_kernel(void* dst, const void* src, size_t nbytes)
+{
+    CopyEngine::copy_nt(dst, src, nbytes);
+}
+
+void
+unpack_mono10p_kernel(void* dst, const void* src, size_t ngroups)
+{
+    unpack_pixels(
+      PixelPacking::Mono10p, (uint16_t*)dst, (const uint8_t*)src, 4 * ngroups);
+}
+
+void
+unpack_mono12p_kernel(void* dst, const void* src, size_t ngroups)
+{
+    unpack_pixels(
+      PixelPacking::Mono12p, (uint16_t*)dst, (const uint8_t*)src, 2 * ngroups);
+}
+
+} // end anonymous namespace
+
+CopyEngine::CopyEngine(size_t nthreads, size_t parallel_threshold_bytes)
+  : parallel_threshold_bytes_(parallel_threshold_bytes)
+  , kernel_(nullptr)
+  , dst_(nullptr)
+  , src_(nullptr)
+  , src_unit_bytes_(0)
+  , dst_unit_bytes_(0)
+  , nunits_(0)
+  , chunk_units_(0)
+  , next_chunk_(0)
+  , nchunks_(0)
+  , chunks_done_(0)
+  , stopping_(false)
+{
+    threads_.reserve(nthreads);
+    for (size_t i = 0; i < nthreads; ++i)
+        threads_.emplace_back([this] { worker_(); });
+}
+
+CopyEngine::~CopyEngine()
+{
+    {
+        const std::scoped_lock lock(lock_);
+        stopping_ = true;
+    }
+    cv_work_.notify_all();
+    for (auto& t : threads_)
+        t.join();
+}
+
+void
+CopyEngine::copy(void* dst, const void* src, size_t nbytes)
+{
+    if (threads_.empty() || nbytes < parallel_threshold_bytes_) {
+        std::memcpy(dst, src, nbytes);
+        return;
+    }
+    run_(copy_kernel, dst, src, nbytes, 1, 1);
+}
+
+void
+CopyEngine::unpack(uint16_t* dst,
+                   const void* src,
+                   size_t npixels,
+                   PixelPacking packing)
+{
+    Kernel kernel = nullptr;
+    switch (packing) {
+        case PixelPacking::Mono10p:
+            kernel = unpack_mono10p_kernel;
+            break;
+        case PixelPacking::Mono12p:
+            kernel = unpack_mono12p_kernel;
+            break;
+        default:
+            copy(dst, src, 2 * npixels);
+            return;
+    }
+    if (threads_.empty() || 2 * npixels < parallel_threshold_bytes_) {
+        unpack_pixels(packing, dst, (const uint8_t*)src, npixels);
+        return;
+    }
+
+    // Workers handle whole groups. The few pixels left over are done here.
+    const auto group = pixel_group(packing);
+    const size_t ngroups = npixels / group.pixels;
+    run_(kernel, dst, src, ngroups, group.bytes, 2 * group.pixels);
+    const size_t done = ngroups * group.pixels;
+    unpack_pixels(packing,
+                  dst + done,
+                  (const uint8_t*)src + ngroups * group.bytes,
+                  npixels - done);
+}
+
+void
+CopyEngine::run_(Kernel kernel,
+                 void* dst,
+                 const void* src,
+                 size_t nunits,
+                 size_t src_unit_bytes,
+                 size_t dst_unit_bytes)
+{
+    // Unpacking fewer pixels than a group leaves nothing for the workers.
+    if (!nunits)
+        return;
+    std::unique_lock<std::mutex> lock(lock_);
+    // The calling thread does its share too.
+    const size_t nworkers = threads_.size() + 1;
+    kernel_ = kernel;
+    dst_ = (uint8_t*)dst;
+    src_ = (const uint8_t*)src;
+    src_unit_bytes_ = src_unit_bytes;
+    dst_unit_bytes_ = dst_unit_bytes;
+    nunits_ = nunits;
+    // Destination unit sizes (1, 4 or 8 bytes) divide the page size.
+    chunk_units_ = round_up((nunits + nworkers - 1) / nworkers,
+                            CHUNK_ALIGNMENT / dst_unit_bytes);
+    nchunks_ = (nunits + chunk_units_ - 1) / chunk_units_;
+    next_chunk_ = 0;
+    chunks_done_ = 0;
+    cv_work_.notify_all();
+
+    while (run_one_chunk_(lock))
+        ;
+    cv_done_.wait(lock, [this] { return chunks_done_ == nchunks_; });
+}
+
+bool
+CopyEngine::run_one_chunk_(std::unique_lock<std::mutex>& lock)
+{
+    if (next_chunk_ >= nchunks_)
+        return false;
+    const size_t beg = chunk_units_ * next_chunk_++;
+    const size_t end = std::min(beg + chunk_units_, nunits_);
+    uint8_t* dst = dst_ + beg * dst_unit_bytes_;
+    const uint8_t* src = src_ + beg * src_unit_bytes_;
+    const Kernel kernel = kernel_;
+
+    lock.unlock();
+    kernel(dst, src, end - beg);
+    lock.lock();
+
+    if (++chunks_done_ == nchunks_)
+        cv_done_.notify_one();
+    return true;
+}
+
+void
+CopyEngine::worker_()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        cv_work_.wait(lock,
+                      [this] { return stopping_ || next_chunk_ < nchunks_; });
+        if (stopping_)
+            return;
+        run_one_chunk_(lock);
+    }
+}
+
+void
+CopyEngine::copy_nt(void* dst, const void* src, size_t nbytes)
+{
+#if defined(__AVX2__)
+    auto* d = (uint8_t*)dst;
+    auto* s = (const uint8_t*)src;
+
+    // Streaming stores need a 32-byte aligned destination.
+    const size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+    if (nbytes < head + 128) {
+        std::memcpy(d, s, nbytes);
+        return;
+    }
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    nbytes -= head;
+
+    const size_t n = nbytes & ~(size_t)127;
+    for (size_t i = 0; i < n; i += 128) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + 32));
+        const __m256i c = _mm256_loadu_si256((const __m256i*)(s + i + 64));
+        const __m256i e = _mm256_loadu_si256((const __m256i*)(s + i + 96));
+        _mm256_stream_si256((__m256i*)(d + i), a);
+        _mm256_stream_si256((__m256i*)(d + i + 32), b);
+        _mm256_stream_si256((__m256i*)(d + i + 64), c);
+        _mm256_stream_si256((__m256i*)(d + i + 96), e);
+    }
+    // Streaming stores are weakly ordered. Make them visible before
+    // reporting the copy as done.
+    _mm_sfence();
+    std::memcpy(d + n, s + n, nbytes - n);
+#else
+    std::memcpy(dst, src, nbytes);
+#endif
+}
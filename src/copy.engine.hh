@@ -0,0 +1,92 @@
+/// @file Parallel frame copies out of DMA buffers.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_COPY_ENGINE_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_COPY_ENGINE_V0
+
+#include "pixel.unpack.hh"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Copies large frames by splitting them across a small persistent pool of
+/// worker threads. Each worker uses non-temporal (streaming) stores when AVX2
+/// is available, so the destination doesn't evict the caller's working set
+/// from cache.
+///
+/// Packed pixel formats are unpacked by the same workers, so the frame is
+/// only read once on its way out of the DMA buffer.
+///
+/// Copies smaller than `parallel_threshold_bytes` (measured at the
+/// destination) are done on the calling thread.
+///
+/// `copy()` and `unpack()` are not re-entrant: only one thread may call
+/// either at a time.
+struct CopyEngine final
+{
+    CopyEngine(size_t nthreads, size_t parallel_threshold_bytes);
+    ~CopyEngine();
+
+    CopyEngine(const CopyEngine&) = delete;
+    CopyEngine& operator=(const CopyEngine&) = delete;
+
+    void copy(void* dst, const void* src, size_t nbytes);
+
+    /// Unpacks `npixels` pixels from `src` into 16-bit pixels at `dst`.
+    void unpack(uint16_t* dst,
+                const void* src,
+                size_t npixels,
+                PixelPacking packing);
+
+    size_t thread_count() const { return threads_.size(); }
+
+    /// Calls `f` with each worker thread, e.g. to set its affinity.
+    template<typename F>
+    void for_each_thread(F&& f)
+    {
+        for (auto& thread : threads_)
+            f(thread);
+    }
+
+    /// Copies `nbytes` using streaming stores on the calling thread. Falls
+    /// back to `memcpy()` when AVX2 isn't available.
+    static void copy_nt(void* dst, const void* src, size_t nbytes);
+
+  private:
+    /// Processes `nunits` units of work. What a unit is depends on the
+    /// kernel: a byte for copies, a pixel group for unpacking.
+    typedef void (*Kernel)(void* dst, const void* src, size_t nunits);
+
+    std::vector<std::thread> threads_;
+    const size_t parallel_threshold_bytes_;
+
+    std::mutex lock_;
+    std::condition_variable cv_work_;
+    std::condition_variable cv_done_;
+
+    // The job currently being processed. Guarded by lock_.
+    Kernel kernel_;
+    uint8_t* dst_;
+    const uint8_t* src_;
+    size_t src_unit_bytes_;
+    size_t dst_unit_bytes_;
+    size_t nunits_;
+    size_t chunk_units_;
+    size_t next_chunk_;
+    size_t nchunks_;
+    size_t chunks_done_;
+    bool stopping_;
+
+    void run_(Kernel kernel,
+              void* dst,
+              const void* src,
+              size_t nunits,
+              size_t src_unit_bytes,
+              size_t dst_unit_bytes);
+    void worker_();
+    bool run_one_chunk_(std::unique_lock<std::mutex>& lock);
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_COPY_ENGINE_V0
@@ -1,5 +1,15 @@
 /// @file Driver wrapping the Euresys EGrabber API.
 /// Written to target the ViewWorks VP-151MX-M6H00
+#include "euresys.egrabber.h"
+#include "copy.engine.hh"
+#include "spsc.ring.hh"
+#include "host.memory.hh"
+#include "frame.layout.hh"
+#include "feature.cache.hh"
+#include "config.plan.hh"
+#include "feature.registry.hh"
+#include "numa.topology.hh"
+#include "thread.priority.hh"
 #include "device/props/camera.h"
 #include "device/kit/camera.h"
 #include "device/kit/driver.h"
@@ -11,10 +21,38 @@
 #include <stdexcept>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include <cmath>
 #include <cstring>
-
-constexpr size_t NBUFFERS = 16;
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <optional>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <type_traits>
+
+// The acquisition thread wakes at least this often to check whether it
+// should stop.
+constexpr uint64_t POP_TIMEOUT_MS = 100;
+
+// While stopping, how often a pop is cancelled again until the acquisition
+// thread is out. Bounds stop latency when a cancel is missed.
+constexpr uint64_t STOP_CANCEL_INTERVAL_US = 200;
+
+// Number of announced buffers that the acquisition thread never hands to
+// consumers, so the grabber always has somewhere to write.
+constexpr size_t RESERVED_BUFFERS = 2;
+
+// Software triggers awaiting their frame that are tracked for latency
+// measurements. Triggers beyond this aren't measured.
+constexpr size_t TRIGGER_QUEUE_CAPACITY = 256;
+
+// How often the thread receiving buffers samples its run queue wait.
+constexpr uint64_t RUN_DELAY_SAMPLE_PERIOD_NS = 100'000'000;
 
 #define countof(e) (sizeof(e) / sizeof(*(e)))
 
@@ -43,9 +81,280 @@ echo_(const std::string& val, int line)
 
 namespace ES = Euresys;
 
+/// Reads a numeric driver option from the environment, falling back to
+/// `dflt` when the variable is unset or doesn't parse.
+double
+env_or(const char* name, double dflt)
+{
+    const char* v = std::getenv(name);
+    if (!v || !*v)
+        return dflt;
+    char* end = nullptr;
+    const double out = std::strtod(v, &end);
+    if (end == v) {
+        LOGE("Ignoring %s=%s. Expected a number.", name, v);
+        return dflt;
+    }
+    return out;
+}
+
+/// Monotonic host time in nanoseconds.
+uint64_t
+steady_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// Defaults for EGrabberBufferPolicy. Each can be overridden with the
+/// environment variable named in the comment.
+EGrabberBufferPolicy
+default_buffer_policy()
+{
+    return {
+        // ACQUIRE_EGRABBER_BUFFER_BUDGET_MB
+        .budget_bytes = (uint64_t)(env_or("ACQUIRE_EGRABBER_BUFFER_BUDGET_MB",
+                                          2048.0) *
+                                   (1ULL << 20)),
+        // ACQUIRE_EGRABBER_BUFFER_SECONDS
+        .seconds = (float)env_or("ACQUIRE_EGRABBER_BUFFER_SECONDS", 0.0),
+        // ACQUIRE_EGRABBER_BUFFER_MIN
+        .min_count = (uint32_t)env_or("ACQUIRE_EGRABBER_BUFFER_MIN", 4),
+        // ACQUIRE_EGRABBER_BUFFER_MAX
+        .max_count = (uint32_t)env_or("ACQUIRE_EGRABBER_BUFFER_MAX", 256),
+        // ACQUIRE_EGRABBER_IMAGES_PER_BUFFER
+        .images_per_buffer =
+          (uint32_t)env_or("ACQUIRE_EGRABBER_IMAGES_PER_BUFFER", 1),
+        // ACQUIRE_EGRABBER_USER_MEMORY
+        .user_memory = (uint8_t)env_or("ACQUIRE_EGRABBER_USER_MEMORY", 0),
+        // ACQUIRE_EGRABBER_PAGE_KB
+        .page_bytes =
+          (uint64_t)env_or("ACQUIRE_EGRABBER_PAGE_KB", 2048.0) * 1024,
+        // ACQUIRE_EGRABBER_NUMA_NODE
+        .numa_node = (int32_t)env_or("ACQUIRE_EGRABBER_NUMA_NODE",
+                                     EGRABBER_NUMA_NODE_GRABBER),
+        // ACQUIRE_EGRABBER_LOCK_MEMORY
+        .lock_memory = (uint8_t)env_or("ACQUIRE_EGRABBER_LOCK_MEMORY", 1),
+    };
+}
+
+/// How long get_frame() waits for a frame before failing.
+/// Override with ACQUIRE_EGRABBER_FRAME_TIMEOUT_MS. Negative means forever.
+uint64_t
+default_frame_timeout_ms()
+{
+    const double v = env_or("ACQUIRE_EGRABBER_FRAME_TIMEOUT_MS", -1.0);
+    return v < 0 ? EGRABBER_INFINITE : (uint64_t)v;
+}
+
+/// How long a device discovery is reused, in seconds.
+/// Override with ACQUIRE_EGRABBER_DISCOVERY_TTL_S. 0 discovers every time.
+double
+default_discovery_ttl_s()
+{
+    return env_or("ACQUIRE_EGRABBER_DISCOVERY_TTL_S", 5.0);
+}
+
+/// Whether to put packed pixel formats (Mono10p, Mono12p) on the wire when
+/// the camera supports them. Frames are unpacked as they're copied out.
+/// Override with ACQUIRE_EGRABBER_PACKED_PIXELS=0.
+bool
+default_prefer_packed_pixels()
+{
+    return env_or("ACQUIRE_EGRABBER_PACKED_PIXELS", 1.0) != 0.0;
+}
+
+/// Set ACQUIRE_EGRABBER_CALLBACKS=1 to receive buffers through the grabber's
+/// callbacks instead of popping them.
+enum EGrabberAcquisitionMode
+default_acquisition_mode()
+{
+    return env_or("ACQUIRE_EGRABBER_CALLBACKS", 0.0) != 0.0
+             ? EGrabberAcquisition_Callback
+             : EGrabberAcquisition_Pop;
+}
+
+/// Most data streams to open per camera. 0 opens every stream the camera
+/// has. Override with ACQUIRE_EGRABBER_DATA_STREAMS.
+size_t
+default_data_stream_limit()
+{
+    return (size_t)std::max(env_or("ACQUIRE_EGRABBER_DATA_STREAMS", 0.0), 0.0);
+}
+
+/// Real-time priority of the thread receiving buffers. 0 for normal
+/// scheduling. Override with ACQUIRE_EGRABBER_RT_PRIORITY.
+int
+default_thread_priority()
+{
+    return (int)env_or("ACQUIRE_EGRABBER_RT_PRIORITY", 0.0);
+}
+
+/// Whether to lock all of the process's current memory in RAM (mlockall)
+/// on the first start, not just the buffers. Affects the whole host
+/// application, so it's off unless ACQUIRE_EGRABBER_LOCK_PROCESS_MEMORY is
+/// set to 1.
+bool
+default_lock_process_memory()
+{
+    return env_or("ACQUIRE_EGRABBER_LOCK_PROCESS_MEMORY", 0.0) != 0;
+}
+
+/// NUMA node the frame grabber is attached to, or -1 when it can't be told.
+int
+detect_grabber_numa_node()
+{
+    const auto nodes = grabber_numa_nodes();
+    const int count = numa_node_count();
+    if (nodes.empty()) {
+        LOG("Frame grabber NUMA node: unknown (%d node(s))", count);
+        return -1;
+    }
+    // With boards on several nodes there's no telling which one this camera
+    // is on.
+    const int node = nodes.front();
+    if (std::any_of(
+          nodes.begin(), nodes.end(), [&](int n) { return n != node; })) {
+        LOG("Frame grabbers are on different NUMA nodes. Not placing buffers "
+            "or threads.");
+        return -1;
+    }
+    LOG("Frame grabber NUMA node: %d (%d node(s))", node, count);
+    return node;
+}
+
+/// NUMA node to run the threads that touch frame data on.
+/// Override with ACQUIRE_EGRABBER_THREAD_NUMA_NODE: -1 leaves them alone,
+/// EGRABBER_NUMA_NODE_GRABBER (the default) follows the frame grabber.
+int
+default_thread_numa_node()
+{
+    return (int)env_or("ACQUIRE_EGRABBER_THREAD_NUMA_NODE",
+                       EGRABBER_NUMA_NODE_GRABBER);
+}
+
+size_t
+bytes_of_type(SampleType type)
+{
+    switch (type) {
+        case SampleType_u8:
+        case SampleType_i8:
+            return 1;
+        case SampleType_f32:
+            return 4;
+        default:
+            // u10, u12 and u14 are stored in 16-bit containers.
+            return 2;
+    }
+}
+
+/// Worker count for the frame copy engine.
+/// Override with ACQUIRE_EGRABBER_COPY_THREADS. 0 disables the worker pool.
+size_t
+default_copy_thread_count()
+{
+    // A few threads are enough to saturate memory bandwidth. Leave the rest
+    // of the machine to the consumer.
+    const size_t dflt =
+      std::clamp<size_t>(std::thread::hardware_concurrency() / 4, 1, 4);
+    return (size_t)env_or("ACQUIRE_EGRABBER_COPY_THREADS", (double)dflt);
+}
+
+/// Frames smaller than this are copied with a plain memcpy.
+/// Override with ACQUIRE_EGRABBER_COPY_PARALLEL_MB.
+size_t
+default_copy_parallel_threshold_bytes()
+{
+    return (size_t)(env_or("ACQUIRE_EGRABBER_COPY_PARALLEL_MB", 8.0) *
+                    (1ULL << 20));
+}
+
+/// Calls `f` with a null pointer to the eGrabber module type for `module`.
+/// The module types are only tags, so a pointer avoids constructing one.
+template<typename F>
+auto
+with_module(enum EGrabberModule module, F&& f)
+{
+    switch (module) {
+        case EGrabberModule_Remote:
+            return f((ES::RemoteModule*)nullptr);
+        case EGrabberModule_Device:
+            return f((ES::DeviceModule*)nullptr);
+        case EGrabberModule_Stream:
+            return f((ES::StreamModule*)nullptr);
+        case EGrabberModule_Interface:
+            return f((ES::InterfaceModule*)nullptr);
+        case EGrabberModule_System:
+            return f((ES::SystemModule*)nullptr);
+    }
+    throw std::runtime_error("Unknown module: " + std::to_string((int)module));
+}
+
+#define MODULE(m) std::remove_pointer_t<decltype(m)>
+
+/// Camera features the driver keeps shadow copies of in EGCamera::features_.
+bool
+is_shadowed_feature(enum EGrabberModule module, const std::string& name)
+{
+    static const char* shadowed[] = { "Width",
+                                      "Height",
+                                      "OffsetX",
+                                      "OffsetY",
+                                      "BinningHorizontal",
+                                      "BinningVertical",
+                                      "PixelFormat",
+                                      "ExposureTime",
+                                      "TriggerMode",
+                                      "TriggerSource",
+                                      "TriggerActivation" };
+    if (module != EGrabberModule_Remote)
+        return false;
+    for (const auto* f : shadowed)
+        if (name == f)
+            return true;
+    return false;
+}
+
+/// A grabber that hands each filled buffer to `on_new_buffer`, on the
+/// grabber's own callback thread, as soon as it's available.
+class CallbackGrabber final : public ES::EGrabber<ES::CallbackMultiThread>
+{
+  public:
+    typedef std::function<void(const ES::NewBufferData&)> Handler;
+
+    /// `info` is an `EGrabberCameraInfo` or, for one data stream, an
+    /// `EGrabberInfo`.
+    template<typename Info>
+    CallbackGrabber(const Info& info, Handler on_new_buffer)
+      : ES::EGrabber<ES::CallbackMultiThread>(info)
+      , on_new_buffer_(std::move(on_new_buffer))
+    {
+    }
+
+    ~CallbackGrabber()
+    {
+        // The callback thread must be gone before on_new_buffer_ is.
+        try {
+            shutdown();
+        } catch (...) {
+            ;
+        }
+    }
+
+  private:
+    Handler on_new_buffer_;
+
+    void onNewBufferEvent(const ES::NewBufferData& data) override
+    {
+        on_new_buffer_(data);
+    }
+};
+
 struct EGCamera final : private Camera
 {
-    explicit EGCamera(const ES::EGrabberCameraInfo& info);
+    EGCamera(const ES::EGrabberCameraInfo& info,
+             enum EGrabberAcquisitionMode mode);
     ~EGCamera();
 
     void set(struct CameraProperties* properties);
@@ -54,20 +363,273 @@ struct EGCamera final : private Camera
     void get_shape(struct ImageShape* shape) const;
     void start();
     void stop();
-    void execute_trigger() const;
+    void execute_trigger();
+    void fire_triggers(uint32_t count, uint64_t interval_us);
     void get_frame(void* im, size_t* nbytes, struct ImageInfo* info);
+    enum EGrabberFrameStatus try_get_frame(void* im,
+                                           size_t* nbytes,
+                                           struct ImageInfo* info,
+                                           uint64_t timeout_ms);
+    void lease_frame(struct EGrabberFrameLease* lease);
+    enum EGrabberFrameStatus try_lease_frame(struct EGrabberFrameLease* lease,
+                                             uint64_t timeout_ms);
+    void release_frame(struct EGrabberFrameLease* lease);
+    void set_buffer_policy(const struct EGrabberBufferPolicy* policy);
+    void get_buffer_policy(struct EGrabberBufferPolicy* policy) const;
+    void get_stats(struct EGrabberStats* stats) const;
+    void set_thread_priority(int32_t priority);
+    void refresh(struct CameraProperties* properties);
+
+    // Each of these returns the number of features that failed. The others
+    // are still registered, read or written.
+    uint32_t register_features(const struct EGrabberFeature* features,
+                               uint32_t count,
+                               uint32_t* handles);
+    uint32_t get_features(struct EGrabberFeatureValue* values, uint32_t count);
+    uint32_t set_features(struct EGrabberFeatureValue* values, uint32_t count);
+
+    // Group membership. join_group() fails when the camera already belongs
+    // to a group.
+    bool join_group() { return !grouped_.exchange(true); }
+    void leave_group() { grouped_ = false; }
+    bool is_grouped() const { return grouped_; }
+
+    // Wakes a consumer waiting on a frame and cancels pending pops, as the
+    // first step of stop(). Safe without lock_.
+    void unblock();
 
   private:
-    mutable ES::EGrabber<> grabber_;
+    // A grabber buffer popped by the acquisition thread. It's handed to the
+    // consumer through ready_ and pushed back to the grabber once the
+    // consumer is done with it.
+    struct Frame
+    {
+        std::optional<ES::Buffer> buffer;
+        uint64_t generation;
+
+        // Number of images delivered into the buffer.
+        uint32_t nparts;
+
+        // Index in streams_ of the data stream the buffer came from.
+        uint32_t stream;
+
+        // The grabber's frame counter for this buffer (BUFFER_INFO_FRAMEID).
+        // With several data streams, the buffer's position in capture order
+        // instead. See merge_frames_().
+        uint64_t frame_id;
+
+        // When buffers hold more than one image, the timestamp of the
+        // previous buffer. Used to spread timestamps over the images.
+        uint64_t previous_timestamp_ns;
+    };
+
+    // One image within a popped buffer. The buffer is requeued once the last
+    // Part referring to it is gone.
+    struct Part
+    {
+        std::shared_ptr<Frame> frame;
+        uint32_t index;
+    };
+
+    // One data stream of the camera and the state of the thread receiving
+    // its buffers. Cameras that spread their frames over several streams
+    // (multi-bank firmware, several DMA engines) have one per stream.
+    struct Stream
+    {
+        // Opened with the callback model matching acquisition_mode_, so only
+        // one of these is set. grabber refers to it.
+        std::unique_ptr<ES::EGrabber<>> pop_grabber;
+        std::unique_ptr<CallbackGrabber> callback_grabber;
+        ES::EGrabberBase* grabber = nullptr;
+
+        // Pops buffers in EGrabberAcquisition_Pop mode. receiving is set
+        // until it leaves acquisition_loop_().
+        std::thread thread;
+        std::atomic<bool> receiving = false;
+        // Held by the callback thread while it handles a buffer, so stop_()
+        // can wait for it.
+        std::mutex callback_lock;
+
+        // Only touched by the receiving thread while acquiring. Reset by
+        // start().
+        bool receiver_ready = false;
+        uint64_t last_timestamp_ns = 0;
+        std::optional<uint64_t> first_frame_id;
+        std::optional<uint64_t> last_frame_id;
+        // Shortest delay from a buffer's timestamp to receiving it. Delays
+        // above it are counted as jitter.
+        int64_t receive_delay_min_ns = INT64_MAX;
+        // The receiving thread's run queue wait when it took its first
+        // buffer, and when it was last sampled (steady clock, ns).
+        std::optional<uint64_t> run_delay_start_ns;
+        uint64_t run_delay_sampled_ns = 0;
+        std::atomic<uint64_t> run_queue_wait_ns = 0;
+    };
+
+    // Set while the camera belongs to an EGGroup.
+    std::atomic<bool> grouped_;
+
+    // How buffers are received. See Stream.
+    const enum EGrabberAcquisitionMode acquisition_mode_;
+    // streams_[0] controls the camera. Everything but buffer handling goes
+    // through grabber_, which refers to its grabber.
+    std::vector<std::unique_ptr<Stream>> streams_;
+    ES::EGrabberBase& grabber_;
+
+    // Shadow copies of the camera settings the driver controls. Every read
+    // and write of those features goes through here. Guarded by lock_.
+    mutable FeatureCache<ES::RemoteModule, ES::EGrabberBase> features_;
+
+    // Features registered for the bulk get/set extensions. Guarded by lock_.
+    FeatureRegistry feature_registry_;
+
     struct CameraProperties last_known_settings_;
-    struct CameraPropertyMetadata last_known_capabilities_;
-    uint64_t frame_id_;
+    // Capabilities are cached. Each section is queried again only after a
+    // write that may have changed it, see meta_dependents_.
+    enum MetaSection : uint32_t
+    {
+        Meta_ExposureTime = 1 << 0,
+        Meta_Binning = 1 << 1,
+        Meta_Offset = 1 << 2,
+        Meta_Shape = 1 << 3,
+        Meta_PixelTypes = 1 << 4,
+        Meta_All = (1 << 5) - 1,
+    };
+    mutable struct CameraPropertyMetadata last_known_capabilities_;
+    // Width and height of the sensor at the current binning, within which
+    // the ROI moves. Refreshed with Meta_Shape.
+    mutable int64_t roi_extent_x_;
+    mutable int64_t roi_extent_y_;
+    mutable uint32_t stale_meta_; // MetaSection flags. Guarded by lock_.
+    // Maps a feature to the sections whose bounds depend on it.
+    const std::unordered_map<std::string, uint32_t> meta_dependents_;
     mutable std::mutex lock_;
 
+    // Incremented every time the grabber's buffers are reallocated. Frames
+    // from an older generation refer to revoked buffers and must not be
+    // pushed back to the grabber.
+    std::atomic<uint64_t> buffer_generation_;
+    std::atomic<size_t> outstanding_leases_;
+
+    // Determines how many buffers are announced to the grabber.
+    struct EGrabberBufferPolicy buffer_policy_;
+    std::atomic<size_t> buffer_count_;
+    size_t images_per_buffer_;
+
+    // What the announced buffers were sized for. They're reused until this
+    // changes.
+    struct BufferGeometry
+    {
+        size_t payload_bytes;
+        size_t images_per_buffer;
+        size_t count;
+        bool user_memory;
+        uint64_t page_bytes;
+        int32_t numa_node;
+        bool lock_memory;
+
+        bool operator==(const BufferGeometry&) const = default;
+    };
+    std::optional<BufferGeometry> buffer_geometry_;
+
+    // Latency of the most recent set() and start(), in milliseconds.
+    std::atomic<double> last_configure_ms_;
+    std::atomic<double> last_start_ms_;
+    // Latency of the most recent stop() and of its phases, in milliseconds.
+    // See EGrabberStats.
+    std::atomic<double> last_stop_ms_;
+    std::atomic<double> stop_unblock_ms_;
+    std::atomic<double> stop_join_ms_;
+    std::atomic<double> stop_grabber_ms_;
+    std::atomic<double> stop_settings_ms_;
+
+    // Backs the grabber's buffers when they are allocated by the driver
+    // (EGrabberBufferPolicy::user_memory). Must outlive their announcement.
+    HostMemory user_memory_;
+
+    // NUMA node of the frame grabber, -1 when unknown. Stands in for
+    // EGRABBER_NUMA_NODE_GRABBER.
+    const int grabber_numa_node_;
+    // CPUs the threads touching frame data are pinned to. Empty to leave
+    // them alone.
+    const std::vector<int> thread_cpus_;
+
+    // Used by get_frame() to copy out of the grabber's buffers.
+    CopyEngine copier_;
+
+    // Buffers are queued here as soon as they are filled, by the acquisition
+    // thread or the grabber's callback thread depending on
+    // acquisition_mode_. get_frame() and lease_frame() are the (single)
+    // consumer. With several data streams, their threads take turns as the
+    // producer under merge_lock_.
+    SpscRing<Frame> ready_;
+    std::atomic<bool> is_running_;
+    // Whether start() succeeded and stop_() hasn't completed since. A stop_()
+    // that failed part way is run again by the next start(). Guarded by
+    // lock_.
+    bool acquiring_;
+
+    // With several data streams, each stream's frames wait here until
+    // they're next in capture order. Guarded by merge_lock_.
+    std::mutex merge_lock_;
+    std::vector<std::deque<Frame>> merge_pending_;
+    uint64_t merge_next_id_;
+
+    // Real-time priority of the thread receiving buffers, 0 for none.
+    // thread_priority_ is guarded by lock_ and copied to receiver_priority_
+    // by start().
+    int thread_priority_;
+    int receiver_priority_;
+    // Whether to lock the whole process's memory on start, and whether that
+    // was tried. Only tried once. Guarded by lock_.
+    bool lock_process_memory_;
+    bool memory_lock_tried_;
+    // Whether the thread receiving buffers runs at receiver_priority_.
+    std::atomic<bool> realtime_;
+
+    // Buffer generation the receiving threads tag frames with. Set by
+    // start().
+    uint64_t receive_generation_;
+    std::atomic<uint64_t> frames_acquired_;
+    // Frames missing from the grabber's frame counter sequence.
+    std::atomic<uint64_t> frames_lost_;
+
+    // When each pending software trigger was fired (steady clock, ns).
+    // deliver_() matches them to frames in order to measure
+    // trigger-to-frame latency. Pushed under lock_.
+    SpscRing<uint64_t> trigger_times_;
+    std::atomic<uint64_t> software_triggers_;
+    std::atomic<uint64_t> triggered_frames_;
+    std::atomic<uint64_t> trigger_latency_sum_ns_;
+    std::atomic<uint64_t> trigger_latency_max_ns_;
+
+    // Receive jitter over buffers_received_ (see
+    // Stream::receive_delay_min_ns) since start().
+    std::atomic<uint64_t> buffers_received_;
+    std::atomic<uint64_t> receive_jitter_sum_ns_;
+    std::atomic<uint64_t> receive_jitter_max_ns_;
+    const uint64_t frame_timeout_ms_;
+
+    // Resolved when acquisition starts so describing a frame doesn't query
+    // the grabber or look up the pixel format. Guarded by lock_, and only
+    // read without it by the consumer while acquiring.
+    FrameLayout layout_;
+
+    // Consumer-side position within the current multi-image buffer.
+    std::shared_ptr<Frame> cursor_frame_;
+    uint32_t cursor_next_part_;
+
     // Maps GenICam PixelFormat names to SampleType.
     const std::unordered_map<std::string, SampleType> px_type_table_;
     const std::unordered_map<SampleType, std::string> px_type_inv_table_;
 
+    // Packed GenICam PixelFormat names, used instead of the ones in
+    // px_type_inv_table_ when prefer_packed_pixels_ is set and the camera
+    // supports them.
+    const std::unordered_map<SampleType, std::string> px_packed_inv_table_;
+    const std::unordered_map<std::string, PixelPacking> px_packing_table_;
+    const bool prefer_packed_pixels_;
+
     // Maps GenICam TriggerActivation names to TriggerEdge
     const std::unordered_map<std::string, TriggerEdge> trig_edge_table_;
     const std::unordered_map<TriggerEdge, std::string> trig_edge_inv_table_;
@@ -87,17 +649,115 @@ struct EGCamera final : private Camera
     void query_roi_shape_capabilities_(CameraPropertyMetadata* meta) const;
     void query_pixel_type_capabilities_(CameraPropertyMetadata* meta) const;
     static void query_triggering_capabilities_(CameraPropertyMetadata* meta);
+    void refresh_meta_() const;
+    void invalidate_meta_(const std::vector<FeatureWrite>& writes);
+
+    // Each of these clamps its target to what the camera supports, adds
+    // the writes needed to reach it to `plan`, and returns the value that
+    // will be in effect once the plan is applied.
+    float plan_exposure_time_us_(float target_us, ConfigPlan* plan);
+    uint8_t plan_binning_(uint8_t target, ConfigPlan* plan);
+    SampleType plan_px_type_(SampleType target, ConfigPlan* plan);
+    void plan_roi_(CameraProperties::camera_properties_offset_s* offset,
+                   CameraProperties::camera_properties_shape_s* shape,
+                   ConfigPlan* plan);
+    void plan_trigger_(Trigger* target, ConfigPlan* plan);
+
+    std::vector<std::unique_ptr<Stream>> open_streams_(
+      const ES::EGrabberCameraInfo& info);
+    uint64_t run_queue_wait_ns_() const;
+
+    void realloc_buffers_();
+    void recycle_buffers_();
+    void announce_user_memory_(size_t count, size_t payload_bytes);
+    size_t compute_buffer_count_(size_t payload_bytes);
+    void log_buffering_();
+    int resolve_numa_node_(int node) const
+    {
+        return node == EGRABBER_NUMA_NODE_GRABBER ? grabber_numa_node_ : node;
+    }
+    double estimate_frame_rate_hz_();
+    void describe_part_(const Part& part,
+                        const void** data,
+                        size_t* nbytes,
+                        struct ImageInfo* info);
+
+    void read_feature_(const FeatureRegistry::Entry& feature,
+                       struct EGrabberFeatureValue* value);
+    void write_feature_(const FeatureRegistry::Entry& feature,
+                        const struct EGrabberFeatureValue& value,
+                        std::vector<FeatureWrite>* shadowed);
+
+    void stop_(std::chrono::steady_clock::time_point since =
+                 std::chrono::steady_clock::now());
+    void fire_trigger_();
+    void acquisition_loop_(size_t stream);
+    void on_new_buffer_(size_t stream, const ES::NewBufferData& data);
+    void prepare_receiver_(Stream& stream);
+    void sample_run_delay_(Stream& stream, uint64_t now_ns);
+    void receive_buffer_(size_t stream, const ES::NewBufferData& data);
+    void merge_frames_();
+    void deliver_(Frame& frame);
+    enum EGrabberFrameStatus next_frame_(uint64_t timeout_ms, Frame* out);
+    enum EGrabberFrameStatus next_part_(uint64_t timeout_ms, Part* out);
+    void requeue_(Frame& frame);
+};
+
+/// Cameras started, stopped and triggered together. Frames are taken from
+/// each camera's queue by the consumer and matched into sets. Each camera
+/// keeps receiving buffers on its own thread, so a slow camera only delays
+/// the sets, not the other cameras.
+struct EGGroup final
+{
+    EGGroup(std::vector<EGCamera*> cameras,
+            const struct EGrabberGroupConfig& config);
+    ~EGGroup();
+
+    EGGroup(const EGGroup&) = delete;
+    EGGroup& operator=(const EGGroup&) = delete;
+
+    void start();
+    void stop();
+    void execute_trigger();
+    enum EGrabberFrameStatus get_frame_set(struct EGrabberFrameLease* leases,
+                                           uint64_t timeout_ms);
+    void release_frame_set(struct EGrabberFrameLease* leases);
+    void get_stats(struct EGrabberGroupStats* stats) const;
+
+  private:
+    const std::vector<EGCamera*> cameras_;
+    const struct EGrabberGroupConfig config_;
+    const uint64_t tolerance_ns_;
+
+    // Serializes the group's operations. Frame sets are taken by a single
+    // consumer, like frames from a camera. get_frame_set() doesn't hold it
+    // while it waits on a camera, so stop() and execute_trigger() aren't
+    // held up by a waiting consumer.
+    mutable std::mutex lock_;
 
-    float maybe_set_exposure_time_us_(float target_us, float last_value_us);
-    uint8_t maybe_set_binning(uint8_t target, uint8_t last_value);
-    SampleType maybe_set_px_type(SampleType target, SampleType last_known);
-    CameraProperties::camera_properties_offset_s maybe_set_offset(
-      CameraProperties::camera_properties_offset_s target,
-      CameraProperties::camera_properties_offset_s last);
-    CameraProperties::camera_properties_shape_s maybe_set_shape(
-      CameraProperties::camera_properties_shape_s target,
-      CameraProperties::camera_properties_shape_s last);
-    void maybe_set_trigger(Trigger& target, const Trigger& last);
+    // Each camera's candidate for the next set, once leased.
+    std::vector<std::optional<struct EGrabberFrameLease>> heads_;
+    // Each camera's first frame id since start(). Frame ids are matched
+    // relative to it, so a camera that misses the first trigger is off by
+    // one for the whole acquisition. The timestamps can tell: see
+    // misaligned_sets_.
+    std::vector<std::optional<uint64_t>> first_frame_ids_;
+    // Counts start() calls, so a wait that spans a stop() and a start()
+    // isn't mistaken for part of the new acquisition.
+    uint64_t runs_;
+
+    uint64_t frame_sets_;
+    uint64_t unmatched_frames_;
+    // Sets matched by frame id whose timestamps are further apart than
+    // tolerance_ns_. Not rejected, since the grabbers' clocks may differ,
+    // but logged.
+    uint64_t misaligned_sets_;
+    uint64_t set_skew_max_ns_;
+    double start_skew_ms_;
+    bool running_;
+
+    int64_t key_(size_t i) const;
+    void release_heads_();
 };
 
 struct EGDriver final : public Driver
@@ -108,11 +768,59 @@ struct EGDriver final : public Driver
     void describe(DeviceIdentifier* identifier, uint64_t i);
     void open(uint64_t device_id, struct Device** out);
     static void close(struct Device* in);
+    void refresh_discovery();
+    void set_acquisition_mode(enum EGrabberAcquisitionMode mode);
+    EGGroup* create_group(struct Camera* const* cameras,
+                          uint32_t count,
+                          const struct EGrabberGroupConfig* config);
 
   private:
     ES::EGenTL gentl_;
+
+    // The result of the last discovery, reused until it's older than
+    // discovery_ttl_ or refresh_discovery() is called. Discovery opens
+    // every camera, so enumerating devices shouldn't repeat it.
+    struct Snapshot
+    {
+        std::vector<ES::EGrabberCameraInfo> cameras;
+        // "<vendor> <model> <serial>", read on first use.
+        std::vector<std::optional<std::string>> names;
+        std::chrono::steady_clock::time_point taken;
+    };
+    std::optional<Snapshot> snapshot_;
+    const std::chrono::duration<double> discovery_ttl_;
+    // For cameras opened from now on. Guarded by lock_.
+    enum EGrabberAcquisitionMode acquisition_mode_;
+    std::mutex lock_;
+
+    const Snapshot& snapshot_locked_();
 };
 
+/// Calls `f(i)` for each i in [0, n), each on a thread of its own. Waits
+/// for all of them, then rethrows the first exception, if any.
+template<typename F>
+void
+run_in_parallel(size_t n, F&& f)
+{
+    std::vector<std::exception_ptr> errors(n);
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                f(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    for (const auto& e : errors)
+        if (e)
+            std::rethrow_exception(e);
+}
+
 template<typename K, typename V>
 V
 at_or(const std::unordered_map<K, V>& table, const K& key, V dflt)
@@ -203,20 +911,15 @@ eecam_stop(struct Camera* self_)
 enum DeviceStatusCode
 eecam_start(struct Camera* self_)
 {
-    // If things didn't get shut down properly before,
-    // sometimes start fails.
-    for (int attempts = 0; attempts < 2; ++attempts) {
-        try {
-            CHECK(self_);
-            ((struct EGCamera*)self_)->start();
-            return Device_Ok;
-        } catch (const std::exception& exc) {
-            LOGE("Exception: %s\n", exc.what());
-        } catch (...) {
-            LOGE("Exception: (unknown)");
-        }
-        LOGE("Retrying camera start");
-        eecam_stop(self_);
+    // start() finishes a stop that failed part way before starting.
+    try {
+        CHECK(self_);
+        ((struct EGCamera*)self_)->start();
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
     }
     return Device_Err;
 }
@@ -254,28 +957,27 @@ eecam_get_frame(struct Camera* self_,
     return Device_Err;
 }
 
-uint32_t
-eecam_device_count(struct Driver* self_)
+enum DeviceStatusCode
+eecam_lease_frame(struct Camera* self_, struct EGrabberFrameLease* lease)
 {
     try {
         CHECK(self_);
-        return ((struct EGDriver*)self_)->device_count();
+        ((struct EGCamera*)self_)->lease_frame(lease);
+        return Device_Ok;
     } catch (const std::exception& exc) {
         LOGE("Exception: %s\n", exc.what());
     } catch (...) {
         LOGE("Exception: (unknown)");
     }
-    return 0;
+    return Device_Err;
 }
 
 enum DeviceStatusCode
-eecam_describe(const struct Driver* self_,
-               struct DeviceIdentifier* identifier,
-               uint64_t i)
+eecam_release_frame(struct Camera* self_, struct EGrabberFrameLease* lease)
 {
     try {
         CHECK(self_);
-        ((struct EGDriver*)self_)->describe(identifier, i);
+        ((struct EGCamera*)self_)->release_frame(lease);
         return Device_Ok;
     } catch (const std::exception& exc) {
         LOGE("Exception: %s\n", exc.what());
@@ -286,11 +988,12 @@ eecam_describe(const struct Driver* self_,
 }
 
 enum DeviceStatusCode
-eecam_open(struct Driver* self_, uint64_t device_id, struct Device** out)
+eecam_set_buffer_policy(struct Camera* self_,
+                        const struct EGrabberBufferPolicy* policy)
 {
     try {
         CHECK(self_);
-        ((struct EGDriver*)self_)->open(device_id, out);
+        ((struct EGCamera*)self_)->set_buffer_policy(policy);
         return Device_Ok;
     } catch (const std::exception& exc) {
         LOGE("Exception: %s\n", exc.what());
@@ -301,11 +1004,12 @@ eecam_open(struct Driver* self_, uint64_t device_id, struct Device** out)
 }
 
 enum DeviceStatusCode
-eecam_close(struct Driver* self_, struct Device* in)
+eecam_get_buffer_policy(const struct Camera* self_,
+                        struct EGrabberBufferPolicy* policy)
 {
     try {
         CHECK(self_);
-        ((struct EGDriver*)self_)->close(in);
+        ((const struct EGCamera*)self_)->get_buffer_policy(policy);
         return Device_Ok;
     } catch (const std::exception& exc) {
         LOGE("Exception: %s\n", exc.what());
@@ -316,11 +1020,11 @@ eecam_close(struct Driver* self_, struct Device* in)
 }
 
 enum DeviceStatusCode
-eecam_shutdown_(struct Driver* self_)
+eecam_get_stats(const struct Camera* self_, struct EGrabberStats* stats)
 {
     try {
         CHECK(self_);
-        delete (EGDriver*)self_;
+        ((const struct EGCamera*)self_)->get_stats(stats);
         return Device_Ok;
     } catch (const std::exception& exc) {
         LOGE("Exception: %s\n", exc.what());
@@ -330,135 +1034,525 @@ eecam_shutdown_(struct Driver* self_)
     return Device_Err;
 }
 
-EGCamera::EGCamera(const ES::EGrabberCameraInfo& info)
-  : Camera{ .set = ::eecam_set,
-            .get = ::eecam_get,
-            .get_meta = ::eecam_get_meta,
-            .get_shape = ::eecam_get_shape,
-            .start = ::eecam_start,
-            .stop = ::eecam_stop,
-            .execute_trigger = ::eecam_execute_trigger,
-            .get_frame = ::eecam_get_frame,
-  }
-  , grabber_(info)
-  , last_known_settings_{}
-  , px_type_table_ {
-        { "Mono8", SampleType_u8 },
-        { "Mono10", SampleType_u10 },
-        { "Mono12", SampleType_u12 },
-        { "Mono14", SampleType_u14 },
-        { "Mono16", SampleType_u16 },
-    }
-  , px_type_inv_table_ {
-      { SampleType_u8 , "Mono8" },
-      { SampleType_u10, "Mono10"},
-      { SampleType_u12, "Mono12"},
-      { SampleType_u14, "Mono14"},
-      { SampleType_u16, "Mono16"},
-  }
-  ,trig_edge_table_{
-      { "RisingEdge", TriggerEdge_Rising },
-      { "FallingEdge", TriggerEdge_Falling },
-      { "AnyEdge", TriggerEdge_AnyEdge },
-      { "LevelHigh", TriggerEdge_LevelHigh },
-      { "LevelLow", TriggerEdge_LevelLow },
-  }
-  ,trig_edge_inv_table_{
-      { TriggerEdge_Rising, "RisingEdge"},
-      { TriggerEdge_Falling, "FallingEdge"},
-      { TriggerEdge_AnyEdge, "AnyEdge"},
-      { TriggerEdge_LevelHigh, "LevelHigh"},
-      { TriggerEdge_LevelLow, "LevelLow"},
-  }
-  , trig_src_table_{
-      { "Line0", Trig_Line0},
-      { "Software", Trig_Software},
-  }
-  , frame_id_(0)
-{
-    grabber_.stop(); // just in case
-    grabber_.execute<ES::RemoteModule>("AcquisitionStop");
-    grabber_.setString<ES::RemoteModule>("TriggerMode", "Off");
-    get(&last_known_settings_);
-    get_meta(&last_known_capabilities_);
-}
-
-EGCamera::~EGCamera()
+enum DeviceStatusCode
+eecam_set_thread_priority(struct Camera* self_, int32_t priority)
 {
     try {
-        stop();
-        // Stop should take care of things but we _really_ want the camera
-        // to stop with triggering disables when it's closed so that it's
-        // available if/when we try to restart it.
-        grabber_.execute<ES::RemoteModule>("AcquisitionStop");
-        grabber_.setString<ES::RemoteModule>("TriggerMode", "Off");
+        CHECK(self_);
+        ((struct EGCamera*)self_)->set_thread_priority(priority);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
     } catch (...) {
-        ;
+        LOGE("Exception: (unknown)");
     }
+    return Device_Err;
 }
 
-void
-EGCamera::set(struct CameraProperties* properties)
+enum DeviceStatusCode
+eecam_fire_triggers(struct Camera* self_,
+                    uint32_t count,
+                    uint64_t interval_us)
 {
-    const std::scoped_lock lock(lock_);
-    using namespace Euresys;
-
-    last_known_settings_.exposure_time_us = maybe_set_exposure_time_us_(
-      properties->exposure_time_us, last_known_settings_.exposure_time_us);
-
-    last_known_settings_.binning =
-      maybe_set_binning(properties->binning, last_known_settings_.binning);
-
-    last_known_settings_.pixel_type = maybe_set_px_type(
-      properties->pixel_type, last_known_settings_.pixel_type);
-
-    last_known_settings_.offset =
-      maybe_set_offset(properties->offset, last_known_settings_.offset);
-
-    last_known_settings_.shape =
-      maybe_set_shape(properties->shape, last_known_settings_.shape);
-
-    maybe_set_trigger(properties->input_triggers.frame_start,
-                      last_known_settings_.input_triggers.frame_start);
-
-    grabber_.reallocBuffers(NBUFFERS);
+    try {
+        CHECK(self_);
+        ((struct EGCamera*)self_)->fire_triggers(count, interval_us);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
 }
 
-template<typename T>
-static T
-clamp(T val, float low, float high)
+enum DeviceStatusCode
+eecam_refresh_properties(struct Camera* self_,
+                         struct CameraProperties* properties)
 {
-    float fval = float(val);
-    return (fval < low)    ? static_cast<T>(low)
-           : (fval > high) ? static_cast<T>(high)
-                           : val;
+    try {
+        CHECK(self_);
+        ((struct EGCamera*)self_)->refresh(properties);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
 }
 
-float
-EGCamera::maybe_set_exposure_time_us_(float target_us, float last_value_us)
+enum DeviceStatusCode
+eecam_register_features(struct Camera* self_,
+                        const struct EGrabberFeature* features,
+                        uint32_t count,
+                        uint32_t* handles)
 {
-    if (fabsf(target_us - last_value_us) > 1e-9) {
-        target_us = clamp(target_us,
-                          last_known_capabilities_.exposure_time_us.low,
-                          last_known_capabilities_.exposure_time_us.high);
-        grabber_.setFloat<Euresys::RemoteModule>("ExposureTime", target_us);
-        return target_us;
+    try {
+        CHECK(self_);
+        const auto failed = ((struct EGCamera*)self_)
+                              ->register_features(features, count, handles);
+        if (!failed)
+            return Device_Ok;
+        LOGE("Failed to register %u of %u features", failed, count);
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+enum DeviceStatusCode
+eecam_get_features(struct Camera* self_,
+                   struct EGrabberFeatureValue* values,
+                   uint32_t count)
+{
+    try {
+        CHECK(self_);
+        const auto failed =
+          ((struct EGCamera*)self_)->get_features(values, count);
+        if (!failed)
+            return Device_Ok;
+        LOGE("Failed to read %u of %u features", failed, count);
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+enum DeviceStatusCode
+eecam_set_features(struct Camera* self_,
+                   struct EGrabberFeatureValue* values,
+                   uint32_t count)
+{
+    try {
+        CHECK(self_);
+        const auto failed =
+          ((struct EGCamera*)self_)->set_features(values, count);
+        if (!failed)
+            return Device_Ok;
+        LOGE("Failed to write %u of %u features", failed, count);
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+enum EGrabberFrameStatus
+eecam_try_get_frame(struct Camera* self_,
+                    void* im,
+                    size_t* nbytes,
+                    struct ImageInfo* info,
+                    uint64_t timeout_ms)
+{
+    try {
+        CHECK(self_);
+        return ((struct EGCamera*)self_)
+          ->try_get_frame(im, nbytes, info, timeout_ms);
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return EGrabberFrame_Error;
+}
+
+uint32_t
+eecam_device_count(struct Driver* self_)
+{
+    try {
+        CHECK(self_);
+        return ((struct EGDriver*)self_)->device_count();
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return 0;
+}
+
+enum DeviceStatusCode
+eecam_describe(const struct Driver* self_,
+               struct DeviceIdentifier* identifier,
+               uint64_t i)
+{
+    try {
+        CHECK(self_);
+        ((struct EGDriver*)self_)->describe(identifier, i);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+enum DeviceStatusCode
+eecam_open(struct Driver* self_, uint64_t device_id, struct Device** out)
+{
+    try {
+        CHECK(self_);
+        ((struct EGDriver*)self_)->open(device_id, out);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+enum DeviceStatusCode
+eecam_close(struct Driver* self_, struct Device* in)
+{
+    try {
+        CHECK(self_);
+        ((struct EGDriver*)self_)->close(in);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+enum DeviceStatusCode
+eecam_shutdown_(struct Driver* self_)
+{
+    try {
+        CHECK(self_);
+        delete (EGDriver*)self_;
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+EGCamera::EGCamera(const ES::EGrabberCameraInfo& info,
+                   enum EGrabberAcquisitionMode mode)
+  : Camera{ .set = ::eecam_set,
+            .get = ::eecam_get,
+            .get_meta = ::eecam_get_meta,
+            .get_shape = ::eecam_get_shape,
+            .start = ::eecam_start,
+            .stop = ::eecam_stop,
+            .execute_trigger = ::eecam_execute_trigger,
+            .get_frame = ::eecam_get_frame,
+  }
+  , grouped_(false)
+  , acquisition_mode_(mode)
+  , streams_(open_streams_(info))
+  , grabber_(*streams_.front()->grabber)
+  , last_known_settings_{}
+  , px_type_table_ {
+        { "Mono8", SampleType_u8 },
+        { "Mono10", SampleType_u10 },
+        { "Mono12", SampleType_u12 },
+        { "Mono14", SampleType_u14 },
+        { "Mono16", SampleType_u16 },
+        { "Mono10p", SampleType_u10 },
+        { "Mono12p", SampleType_u12 },
+    }
+  , px_type_inv_table_ {
+      { SampleType_u8 , "Mono8" },
+      { SampleType_u10, "Mono10"},
+      { SampleType_u12, "Mono12"},
+      { SampleType_u14, "Mono14"},
+      { SampleType_u16, "Mono16"},
+  }
+  , px_packed_inv_table_ {
+      { SampleType_u10, "Mono10p"},
+      { SampleType_u12, "Mono12p"},
+  }
+  , px_packing_table_ {
+      { "Mono10p", PixelPacking::Mono10p },
+      { "Mono12p", PixelPacking::Mono12p },
+  }
+  , prefer_packed_pixels_(default_prefer_packed_pixels())
+  ,trig_edge_table_{
+      { "RisingEdge", TriggerEdge_Rising },
+      { "FallingEdge", TriggerEdge_Falling },
+      { "AnyEdge", TriggerEdge_AnyEdge },
+      { "LevelHigh", TriggerEdge_LevelHigh },
+      { "LevelLow", TriggerEdge_LevelLow },
+  }
+  ,trig_edge_inv_table_{
+      { TriggerEdge_Rising, "RisingEdge"},
+      { TriggerEdge_Falling, "FallingEdge"},
+      { TriggerEdge_AnyEdge, "AnyEdge"},
+      { TriggerEdge_LevelHigh, "LevelHigh"},
+      { TriggerEdge_LevelLow, "LevelLow"},
+  }
+  , trig_src_table_{
+      { "Line0", Trig_Line0},
+      { "Software", Trig_Software},
+  }
+  , features_(grabber_)
+  , roi_extent_x_(0)
+  , roi_extent_y_(0)
+  , stale_meta_(Meta_All)
+  , meta_dependents_{
+      { "PixelFormat", Meta_ExposureTime | Meta_Offset | Meta_Shape },
+      { "BinningHorizontal", Meta_ExposureTime | Meta_Offset | Meta_Shape },
+      { "BinningVertical", Meta_ExposureTime | Meta_Offset | Meta_Shape },
+      // The largest offset leaves room for the ROI, and vice versa.
+      { "Width", Meta_Offset },
+      { "Height", Meta_Offset },
+      { "OffsetX", Meta_Shape },
+      { "OffsetY", Meta_Shape },
+  }
+  , buffer_generation_(0)
+  , outstanding_leases_(0)
+  , buffer_policy_(default_buffer_policy())
+  , buffer_count_(0)
+  , images_per_buffer_(1)
+  , last_configure_ms_(0)
+  , last_start_ms_(0)
+  , last_stop_ms_(0)
+  , stop_unblock_ms_(0)
+  , stop_join_ms_(0)
+  , stop_grabber_ms_(0)
+  , stop_settings_ms_(0)
+  , grabber_numa_node_(detect_grabber_numa_node())
+  , thread_cpus_(numa_node_cpus(
+      resolve_numa_node_(default_thread_numa_node())))
+  , copier_(default_copy_thread_count(),
+            default_copy_parallel_threshold_bytes())
+  , ready_(1)
+  , is_running_(false)
+  , acquiring_(false)
+  , merge_pending_(streams_.size())
+  , merge_next_id_(0)
+  , thread_priority_(default_thread_priority())
+  , receiver_priority_(0)
+  , lock_process_memory_(default_lock_process_memory())
+  , memory_lock_tried_(false)
+  , realtime_(false)
+  , receive_generation_(0)
+  , frames_acquired_(0)
+  , frames_lost_(0)
+  , trigger_times_(TRIGGER_QUEUE_CAPACITY)
+  , software_triggers_(0)
+  , triggered_frames_(0)
+  , trigger_latency_sum_ns_(0)
+  , trigger_latency_max_ns_(0)
+  , buffers_received_(0)
+  , receive_jitter_sum_ns_(0)
+  , receive_jitter_max_ns_(0)
+  , frame_timeout_ms_(default_frame_timeout_ms())
+  , cursor_next_part_(0)
+{
+    LOG("Receiving buffers from %d data stream(s) %s",
+        (int)streams_.size(),
+        acquisition_mode_ == EGrabberAcquisition_Callback
+          ? "through grabber callbacks"
+          : "on an acquisition thread each");
+    LOG("Copying frames over %.1f MB with %d worker thread(s)",
+        1e-6 * (double)default_copy_parallel_threshold_bytes(),
+        (int)copier_.thread_count());
+    if (!thread_cpus_.empty()) {
+        int pinned = 0;
+        copier_.for_each_thread(
+          [&](std::thread& t) { pinned += pin_thread(t, thread_cpus_); });
+        LOG("Pinned %d of %d copy thread(s) to %d CPU(s) on NUMA node %d",
+            pinned,
+            (int)copier_.thread_count(),
+            (int)thread_cpus_.size(),
+            resolve_numa_node_(default_thread_numa_node()));
+    }
+    // Writing these can change the current value of the others. Anything
+    // else the camera derives from them (limits, frame rate) isn't cached.
+    features_.add_dependency("BinningHorizontal", { "Width", "OffsetX" });
+    features_.add_dependency("BinningVertical", { "Height", "OffsetY" });
+    features_.add_dependency("PixelFormat",
+                             { "Width", "Height", "OffsetX", "OffsetY" });
+    features_.add_dependency("Width", { "OffsetX" });
+    features_.add_dependency("Height", { "OffsetY" });
+
+    for (auto& stream : streams_)
+        stream->grabber->stop(); // just in case
+    grabber_.execute<ES::RemoteModule>("AcquisitionStop");
+    features_.set_string("TriggerMode", "Off");
+    get(&last_known_settings_);
+    {
+        const std::scoped_lock lock(lock_);
+        refresh_meta_();
+    }
+}
+
+EGCamera::~EGCamera()
+{
+    try {
+        stop();
+        // Stop should take care of things but we _really_ want the camera
+        // to stop with triggering disables when it's closed so that it's
+        // available if/when we try to restart it.
+        grabber_.execute<ES::RemoteModule>("AcquisitionStop");
+        features_.set_string("TriggerMode", "Off");
+        // Revoke buffers backed by user_memory_ before it is freed.
+        if (user_memory_.data()) {
+            for (auto& stream : streams_)
+                stream->grabber->reallocBuffers(0);
+        }
+    } catch (...) {
+        ;
+    }
+}
+
+std::vector<std::unique_ptr<EGCamera::Stream>>
+EGCamera::open_streams_(const ES::EGrabberCameraInfo& info)
+{
+    // The first stream is opened from the camera, like a single-stream
+    // camera, so it gets the remote device. The others only carry data.
+    const size_t available = std::max<size_t>(info.grabbers.size(), 1);
+    const size_t limit = default_data_stream_limit();
+    const size_t n = limit ? std::min(available, limit) : available;
+    if (n < available) {
+        LOG("Opening %d of the camera's %d data streams",
+            (int)n,
+            (int)available);
+    }
+
+    std::vector<std::unique_ptr<Stream>> streams;
+    for (size_t i = 0; i < n; ++i) {
+        auto stream = std::make_unique<Stream>();
+        switch (acquisition_mode_) {
+            case EGrabberAcquisition_Pop:
+                stream->pop_grabber =
+                  i ? std::make_unique<ES::EGrabber<>>(info.grabbers[i])
+                    : std::make_unique<ES::EGrabber<>>(info);
+                stream->grabber = stream->pop_grabber.get();
+                break;
+            case EGrabberAcquisition_Callback: {
+                const auto on_new_buffer =
+                  [this, i](const ES::NewBufferData& data) {
+                      on_new_buffer_(i, data);
+                  };
+                stream->callback_grabber =
+                  i ? std::make_unique<CallbackGrabber>(info.grabbers[i],
+                                                        on_new_buffer)
+                    : std::make_unique<CallbackGrabber>(info, on_new_buffer);
+                stream->grabber = stream->callback_grabber.get();
+                break;
+            }
+        }
+        EXPECT(stream->grabber,
+               "Unknown acquisition mode: %d",
+               (int)acquisition_mode_);
+        streams.push_back(std::move(stream));
     }
-    return last_value_us;
+    return streams;
+}
+
+void
+EGCamera::set(struct CameraProperties* properties)
+{
+    const std::scoped_lock lock(lock_);
+    const auto t0 = std::chrono::steady_clock::now();
+    auto& last = last_known_settings_;
+
+    // Pixel format and binning change the valid range of the ROI, so they
+    // are applied before the rest is planned.
+    // Targets are clamped to the camera's capabilities.
+    refresh_meta_();
+    ConfigPlan format;
+    last.pixel_type = plan_px_type_(properties->pixel_type, &format);
+    last.binning = plan_binning_(properties->binning, &format);
+    features_.apply(format.writes());
+    invalidate_meta_(format.writes());
+    refresh_meta_();
+
+    ConfigPlan plan;
+    plan_roi_(&properties->offset, &properties->shape, &plan);
+    last.offset = properties->offset;
+    last.shape = properties->shape;
+    last.exposure_time_us =
+      plan_exposure_time_us_(properties->exposure_time_us, &plan);
+    plan_trigger_(&properties->input_triggers.frame_start, &plan);
+    last.input_triggers.frame_start = properties->input_triggers.frame_start;
+    features_.apply(plan.writes());
+    invalidate_meta_(plan.writes());
+
+    // Only does anything if the payload size or buffer policy changed.
+    realloc_buffers_();
+
+    const std::chrono::duration<double, std::milli> dt =
+      std::chrono::steady_clock::now() - t0;
+    last_configure_ms_ = dt.count();
+    LOG("Configured in %.1f ms (%d feature writes)",
+        dt.count(),
+        (int)(format.writes().size() + plan.writes().size()));
+}
+
+template<typename T>
+static T
+clamp(T val, float low, float high)
+{
+    float fval = float(val);
+    return (fval < low)    ? static_cast<T>(low)
+           : (fval > high) ? static_cast<T>(high)
+                           : val;
+}
+
+float
+EGCamera::plan_exposure_time_us_(float target_us, ConfigPlan* plan)
+{
+    target_us = clamp(target_us,
+                      last_known_capabilities_.exposure_time_us.low,
+                      last_known_capabilities_.exposure_time_us.high);
+    plan->write_if_changed(
+      "ExposureTime", features_.get_float("ExposureTime"), target_us);
+    return target_us;
 }
 
 void
 EGCamera::get_meta(struct CameraPropertyMetadata* meta) const
 {
     const std::scoped_lock lock(lock_);
-    query_exposure_time_capabilities_(meta);
-    meta->line_interval_us = { .writable = false };
-    meta->readout_direction = { .writable = false };
-    query_binning_capabilities_(meta);
-    query_roi_offset_capabilities_(meta);
-    query_roi_shape_capabilities_(meta);
-    query_pixel_type_capabilities_(meta);
-    query_triggering_capabilities_(meta);
+    refresh_meta_();
+    *meta = last_known_capabilities_;
+}
+
+void
+EGCamera::refresh_meta_() const
+{
+    // Locking: Expects lock_ to be held by the caller.
+    if (!stale_meta_)
+        return;
+    auto* meta = &last_known_capabilities_;
+    if (stale_meta_ == Meta_All) {
+        meta->line_interval_us = { .writable = false };
+        meta->readout_direction = { .writable = false };
+        query_triggering_capabilities_(meta);
+    }
+    if (stale_meta_ & Meta_ExposureTime)
+        query_exposure_time_capabilities_(meta);
+    if (stale_meta_ & Meta_Binning)
+        query_binning_capabilities_(meta);
+    if (stale_meta_ & Meta_Offset)
+        query_roi_offset_capabilities_(meta);
+    if (stale_meta_ & Meta_Shape)
+        query_roi_shape_capabilities_(meta);
+    if (stale_meta_ & Meta_PixelTypes)
+        query_pixel_type_capabilities_(meta);
+    stale_meta_ = 0;
+}
+
+void
+EGCamera::invalidate_meta_(const std::vector<FeatureWrite>& writes)
+{
+    for (const auto& w : writes)
+        stale_meta_ |= at_or(meta_dependents_, w.name, 0u);
 }
 
 void
@@ -543,6 +1637,15 @@ EGCamera::query_roi_shape_capabilities_(CameraPropertyMetadata* meta) const
           .type = PropertyType_FixedPrecision,
         },
     };
+    // The largest size above is what's left of the sensor past the current
+    // offset. Without WidthMax and HeightMax, the two add up to the sensor.
+    const auto extent = [&](const char* max, const char* offset, float high) {
+        if (grabber_.getInteger<RemoteModule>(query::available(max)))
+            return grabber_.getInteger<RemoteModule>(max);
+        return features_.get_integer(offset) + (int64_t)high;
+    };
+    roi_extent_x_ = extent("WidthMax", "OffsetX", meta->shape.x.high);
+    roi_extent_y_ = extent("HeightMax", "OffsetY", meta->shape.y.high);
 }
 
 void
@@ -579,17 +1682,17 @@ EGCamera::get(struct CameraProperties* properties)
     const std::scoped_lock lock(lock_);
     using namespace Euresys;
     *properties = {
-        .exposure_time_us = (float)grabber_.getFloat<RemoteModule>(echo("ExposureTime")),
-        .binning = (uint8_t)grabber_.getInteger<RemoteModule>(echo("BinningHorizontal")),
+        .exposure_time_us = (float)features_.get_float(echo("ExposureTime")),
+        .binning = (uint8_t)features_.get_integer(echo("BinningHorizontal")),
         .pixel_type =
-          at_or(px_type_table_,grabber_.getString<RemoteModule>(echo("PixelFormat")),SampleType_Unknown),
+          at_or(px_type_table_,features_.get_string(echo("PixelFormat")),SampleType_Unknown),
         .offset = {
-          .x = (uint32_t)grabber_.getInteger<RemoteModule>(echo("OffsetX")),
-          .y = (uint32_t)grabber_.getInteger<RemoteModule>(echo("OffsetY")),
+          .x = (uint32_t)features_.get_integer(echo("OffsetX")),
+          .y = (uint32_t)features_.get_integer(echo("OffsetY")),
         },
         .shape = {
-          .x = (uint32_t)grabber_.getInteger<RemoteModule>(echo("Width")),
-          .y = (uint32_t)grabber_.getInteger<RemoteModule>(echo("Height")),
+          .x = (uint32_t)features_.get_integer(echo("Width")),
+          .y = (uint32_t)features_.get_integer(echo("Height")),
         },
     };
     {
@@ -609,7 +1712,7 @@ EGCamera::get(struct CameraProperties* properties)
         // Read from trigger source
         const auto src =
           at_or(trig_src_table_,
-                grabber_.getString<RemoteModule>(echo("TriggerSource")),
+                features_.get_string(echo("TriggerSource")),
                 Trig_Unknown);
         switch (src) {
             case Trig_Line0:
@@ -617,12 +1720,12 @@ EGCamera::get(struct CameraProperties* properties)
                 // The only TriggerSelector on the vieworks is ExposureStart.
                 // Treat that as frame_start here.
                 properties->input_triggers.frame_start = {
-                    .enable = (uint8_t)grabber_.getInteger<RemoteModule>(
-                      echo("TriggerMode")),
+                    .enable = (uint8_t)(features_.get_string(
+                                          echo("TriggerMode")) == "On"),
                     .line = static_cast<uint8_t>(src),
                     .kind = Signal_Input,
                     .edge = at_or(trig_edge_table_,
-                                  grabber_.getString<RemoteModule>(
+                                  features_.get_string(
                                     echo("TriggerActivation")),
                                   TriggerEdge_Unknown),
                 };
@@ -634,148 +1737,1139 @@ EGCamera::get(struct CameraProperties* properties)
     last_known_settings_ = *properties;
 }
 uint8_t
-EGCamera::maybe_set_binning(uint8_t target, uint8_t last_value)
+EGCamera::plan_binning_(uint8_t target, ConfigPlan* plan)
 {
     // FIXME: on some cameras it seems like only horizontal or vertical are
     // writable
     //        this might be when binning is unsupported - i.e only binning=1 is
     //        available.
-    if (target != last_value) {
-        target = clamp(target,
-                       last_known_capabilities_.binning.low,
-                       last_known_capabilities_.binning.high);
-        if (last_known_capabilities_.binning.writable) {
-            grabber_.setInteger<ES::RemoteModule>(echo("BinningHorizontal"),
-                                                  target);
-            grabber_.setInteger<ES::RemoteModule>(echo("BinningVertical"),
-                                                  target);
-        }
-        return target;
+    target = clamp(target,
+                   last_known_capabilities_.binning.low,
+                   last_known_capabilities_.binning.high);
+    if (last_known_capabilities_.binning.writable) {
+        plan->write_if_changed(echo("BinningHorizontal"),
+                               features_.get_integer("BinningHorizontal"),
+                               target);
+        plan->write_if_changed(echo("BinningVertical"),
+                               features_.get_integer("BinningVertical"),
+                               target);
     }
-    return last_value;
+    return target;
 }
 
 SampleType
-EGCamera::maybe_set_px_type(SampleType target, SampleType last_known)
+EGCamera::plan_px_type_(SampleType target, ConfigPlan* plan)
 {
     CHECK(target < SampleTypeCount);
-    if (target != last_known) {
-        grabber_.setString<ES::RemoteModule>(echo("PixelFormat"),
-                                             px_type_inv_table_.at(target));
+    const auto current = features_.get_string("PixelFormat");
+    // Either of the packed and unpacked formats will do.
+    if (at_or(px_type_table_, current, SampleType_Unknown) == target)
         return target;
-    }
-    return last_known;
-}
-CameraProperties::camera_properties_offset_s
-EGCamera::maybe_set_offset(CameraProperties::camera_properties_offset_s target,
-                           CameraProperties::camera_properties_offset_s last)
-{
-    if (target.x != last.x) {
-
-        target.x = clamp(target.x,
-                         last_known_capabilities_.offset.x.low,
-                         last_known_capabilities_.offset.x.high);
-        grabber_.setInteger<ES::RemoteModule>(echo("OffsetX"), target.x);
-        last.x = target.x;
-    }
-    if (target.y != last.y) {
 
-        target.y = clamp(target.y,
-                         last_known_capabilities_.offset.y.low,
-                         last_known_capabilities_.offset.y.high);
-        grabber_.setInteger<ES::RemoteModule>(echo("OffsetY"), target.y);
-        last.y = target.y;
+    auto name = px_type_inv_table_.at(target);
+    const auto packed = px_packed_inv_table_.find(target);
+    if (prefer_packed_pixels_ && packed != px_packed_inv_table_.end()) {
+        const auto formats = grabber_.getStringList<ES::RemoteModule>(
+          ES::query::enumEntries("PixelFormat"));
+        if (std::find(formats.begin(), formats.end(), packed->second) !=
+            formats.end())
+            name = packed->second;
     }
-    return last;
+    plan->write_if_changed(echo("PixelFormat"), current, name);
+    return target;
 }
 
-CameraProperties::camera_properties_shape_s
-EGCamera::maybe_set_shape(CameraProperties::camera_properties_shape_s target,
-                          CameraProperties::camera_properties_shape_s last)
+void
+EGCamera::plan_roi_(CameraProperties::camera_properties_offset_s* offset,
+                    CameraProperties::camera_properties_shape_s* shape,
+                    ConfigPlan* plan)
 {
-    if (target.x != last.x) {
-        target.x = clamp(target.x,
-                         last_known_capabilities_.shape.x.low,
-                         last_known_capabilities_.shape.x.high);
-        grabber_.setInteger<ES::RemoteModule>(echo("Width"), target.x);
-        last.x = target.x;
-    }
-    if (target.y != last.y) {
-        target.y = clamp(target.y,
-                         last_known_capabilities_.shape.y.low,
-                         last_known_capabilities_.shape.y.high);
-        grabber_.setInteger<ES::RemoteModule>(echo("Height"), target.y);
-        last.y = target.y;
-    }
-    return last;
+    // The camera's offset and size limits each depend on the other's
+    // current value, so they would clamp a ROI that is moved and resized at
+    // once. Clamp the targets against the sensor instead.
+    const auto& caps = last_known_capabilities_;
+    const auto clamp_axis = [](uint32_t* offset,
+                               uint32_t* size,
+                               const struct Property& offset_caps,
+                               const struct Property& size_caps,
+                               int64_t extent) {
+        *size =
+          clamp(*size, size_caps.low, (float)extent - offset_caps.low);
+        *offset =
+          clamp(*offset, offset_caps.low, (float)(extent - (int64_t)*size));
+    };
+    clamp_axis(
+      &offset->x, &shape->x, caps.offset.x, caps.shape.x, roi_extent_x_);
+    clamp_axis(
+      &offset->y, &shape->y, caps.offset.y, caps.shape.y, roi_extent_y_);
+
+    plan->write_roi_axis(echo("OffsetX"),
+                         echo("Width"),
+                         features_.get_integer("OffsetX"),
+                         features_.get_integer("Width"),
+                         offset->x,
+                         shape->x);
+    plan->write_roi_axis(echo("OffsetY"),
+                         echo("Height"),
+                         features_.get_integer("OffsetY"),
+                         features_.get_integer("Height"),
+                         offset->y,
+                         shape->y);
 }
 
-bool
-is_equal(const Trigger& lhs, const Trigger& rhs)
+void
+EGCamera::plan_trigger_(Trigger* target, ConfigPlan* plan)
 {
-    return memcmp(&lhs, &rhs, sizeof(Trigger)) == 0;
+    // Only consider frame_start
+    const char* sources[] = { "Line0", "Software" };
+    const char* modes[] = { "Off", "On" };
+    const char* activations[] = { "RisingEdge", "FallingEdge" };
+
+    // constraints
+    // These are assumptions used in the code below.
+    EXPECT(target->line < 2,
+           "Trigger line must be Line0 (0) or Software (1). Got: %d",
+           target->line);
+    EXPECT(target->edge < countof(activations),
+           "Trigger edge must be Rising (%d) or Falling (%d). Got: %d",
+           TriggerEdge_Rising,
+           TriggerEdge_Falling,
+           target->edge);
+    EXPECT(target->enable < 2,
+           "Expect trigger enable to be 0 or 1. Got: %d",
+           target->enable);
+    target->kind = Signal_Input; // force for Vieworks
+
+    // Enable triggering last, once source and activation are in place.
+    plan->write_if_changed(echo("TriggerSource"),
+                           features_.get_string("TriggerSource"),
+                           sources[target->line]);
+    plan->write_if_changed(echo("TriggerActivation"),
+                           features_.get_string("TriggerActivation"),
+                           activations[target->edge]);
+    plan->write_if_changed(echo("TriggerMode"),
+                           features_.get_string("TriggerMode"),
+                           modes[target->enable]);
 }
 
 void
-EGCamera::maybe_set_trigger(Trigger& target, const Trigger& last)
+EGCamera::start()
 {
-    // Only consider frame_start
-    if (is_equal(target, last))
-        return; // No change
-
+    const std::scoped_lock lock(lock_);
+    const auto t0 = std::chrono::steady_clock::now();
+    if (acquiring_)
+        stop_();
+
+    frames_acquired_ = 0;
+    frames_lost_ = 0;
+    trigger_times_.reset(TRIGGER_QUEUE_CAPACITY);
+    software_triggers_ = 0;
+    triggered_frames_ = 0;
+    trigger_latency_sum_ns_ = 0;
+    trigger_latency_max_ns_ = 0;
+    buffers_received_ = 0;
+    receive_jitter_sum_ns_ = 0;
+    receive_jitter_max_ns_ = 0;
+    cursor_frame_.reset();
+    recycle_buffers_();
+    realloc_buffers_();
+    log_buffering_();
+    if (thread_priority_ > 0 &&
+        !(buffer_policy_.user_memory && buffer_policy_.lock_memory))
+        LOG("Real-time priority without locked buffers: the receiving "
+            "thread may wait on page faults. Set lock_memory in a "
+            "user_memory buffer policy to lock them.");
+    if (lock_process_memory_ && !memory_lock_tried_) {
+        // After the buffers are in place, so they're locked too.
+        std::string error;
+        if (lock_process_memory(&error))
+            LOG("Locked the process's memory in RAM");
+        else
+            LOGE("Could not lock the process's memory in RAM: %s",
+                 error.c_str());
+        memory_lock_tried_ = true;
+    }
     {
-        const char* sources[] = { "Line0", "Software" };
-        const char* modes[] = { "Off", "On" };
-        const char* activations[] = { "RisingEdge", "FallingEdge" };
-
-        // constraints
-        // These are assumptions used in the code below.
-        EXPECT(target.line < 2,
-               "Trigger line must be Line0 (0) or Software (1). Got: %d",
-               target.line);
-        EXPECT(target.edge < countof(activations),
-               "Trigger edge must be Rising (%d) or Falling (%d). Got: %d",
-               TriggerEdge_Rising,
-               TriggerEdge_Falling,
-               target.edge);
-        EXPECT(target.enable < 2,
-               "Expect trigger enable to be 0 or 1. Got: %d",
-               target.enable);
-        target.kind = Signal_Input; // force for Vieworks
-
-        grabber_.setString<ES::RemoteModule>(echo("TriggerSource"),
-                                             sources[target.line]);
-        grabber_.setString<ES::RemoteModule>(echo("TriggerMode"),
-                                             modes[target.enable]);
-        grabber_.setString<ES::RemoteModule>(echo("TriggerActivation"),
-                                             activations[target.edge]);
+        const auto format = features_.get_string("PixelFormat");
+        const auto type = at_or(px_type_table_, format, SampleType_Unknown);
+        layout_ = FrameLayout(
+          (uint32_t)features_.get_integer("Width"),
+          (uint32_t)features_.get_integer("Height"),
+          type,
+          bytes_of_type(type),
+          at_or(px_packing_table_, format, PixelPacking::None),
+          (uint32_t)images_per_buffer_);
+        // The payload covers every part of a buffer, so the stride between
+        // them is known before the first buffer arrives.
+        if (images_per_buffer_ > 1 && buffer_geometry_) {
+            layout_.part_stride_bytes =
+              buffer_geometry_->payload_bytes / images_per_buffer_;
+        }
+    }
+    // Each stream keeps RESERVED_BUFFERS with the grabber.
+    ready_.reset(std::max<size_t>(
+      buffer_count_ - RESERVED_BUFFERS * streams_.size(), 1));
+    receive_generation_ = buffer_generation_;
+    for (auto& stream : streams_) {
+        stream->receiver_ready = false;
+        stream->last_timestamp_ns = 0;
+        stream->first_frame_id.reset();
+        stream->last_frame_id.reset();
+        stream->receive_delay_min_ns = INT64_MAX;
+        stream->run_delay_start_ns.reset();
+        stream->run_queue_wait_ns = 0;
+    }
+    merge_next_id_ = 0;
+    receiver_priority_ = thread_priority_;
+    // A new acquisition thread starts at normal priority. The callback
+    // thread keeps whatever it had.
+    if (acquisition_mode_ == EGrabberAcquisition_Pop)
+        realtime_ = false;
+
+    // Set first: callbacks can deliver buffers as soon as the grabber starts.
+    // The streams that only carry data are started before the one that
+    // starts the camera, so none misses the first frames.
+    is_running_ = true;
+    size_t started = 0;
+    try {
+        for (; started < streams_.size(); ++started) {
+            const size_t i = streams_.size() - 1 - started;
+            streams_[i]->grabber->start(GENTL_INFINITE, i == 0);
+        }
+    } catch (...) {
+        is_running_ = false;
+        for (size_t i = streams_.size() - started; i < streams_.size(); ++i)
+            streams_[i]->grabber->stop();
+        throw;
+    }
+    acquiring_ = true;
+    if (acquisition_mode_ == EGrabberAcquisition_Pop) {
+        for (size_t i = 0; i < streams_.size(); ++i) {
+            streams_[i]->receiving = true;
+            streams_[i]->thread =
+              std::thread([this, i] { acquisition_loop_(i); });
+        }
     }
+
+    const std::chrono::duration<double, std::milli> dt =
+      std::chrono::steady_clock::now() - t0;
+    last_start_ms_ = dt.count();
+    LOG("Started in %.1f ms", dt.count());
 }
 
 void
-EGCamera::start()
+EGCamera::recycle_buffers_()
 {
-    const std::scoped_lock lock(lock_);
-    frame_id_ = 0;
-    grabber_.reallocBuffers(NBUFFERS);
-    grabber_.start();
+    // Locking: Expects lock_ to be held by the caller, and acquisition to be
+    // stopped.
+    if (!buffer_geometry_)
+        return;
+
+    // Buffers still in ready_ or held by a lease were never pushed back.
+    // Return every announced buffer to the input queue instead. Frames from
+    // the previous acquisition must not be pushed again after this.
+    ready_.reset(1);
+    for (auto& pending : merge_pending_)
+        pending.clear();
+    ++buffer_generation_;
+    for (auto& stream : streams_)
+        stream->grabber->resetBufferQueue();
+}
+
+void
+EGCamera::realloc_buffers_()
+{
+    // Locking: Expects lock_ to be held by the caller.
+    const size_t parts =
+      std::max<uint32_t>(buffer_policy_.images_per_buffer, 1);
+    if (!buffer_geometry_ || buffer_geometry_->images_per_buffer != parts) {
+        if (grabber_.getInteger<ES::StreamModule>(
+              ES::query::available("BufferPartCount"))) {
+            for (auto& stream : streams_) {
+                stream->grabber->setInteger<ES::StreamModule>(
+                  "BufferPartCount", parts);
+            }
+        } else {
+            EXPECT(parts == 1,
+                   "Can't pack %d images per buffer: BufferPartCount is not "
+                   "available.",
+                   (int)parts);
+        }
+    }
+    images_per_buffer_ = parts;
+
+    // Includes every image in the buffer. Each data stream gets its share
+    // of the buffers, since it gets its share of the frames.
+    const size_t payload_bytes = grabber_.getPayloadSize();
+    const size_t nstreams = streams_.size();
+    const size_t per_stream =
+      std::max<size_t>((compute_buffer_count_(payload_bytes) + nstreams - 1) /
+                         nstreams,
+                       RESERVED_BUFFERS);
+    const size_t n = per_stream * nstreams;
+    const auto& p = buffer_policy_;
+    const BufferGeometry geometry = {
+        .payload_bytes = payload_bytes,
+        .images_per_buffer = parts,
+        .count = n,
+        .user_memory = p.user_memory != 0,
+        // Allocation preferences only matter for user memory.
+        .page_bytes = p.user_memory ? p.page_bytes : 0,
+        .numa_node = resolve_numa_node_(p.numa_node),
+        .lock_memory = p.user_memory && p.lock_memory,
+    };
+    if (buffer_geometry_ == geometry)
+        return;
+
+    if (const auto leases = outstanding_leases_.load()) {
+        LOGE("Reallocating buffers with %d frame(s) still leased. "
+             "Those leases are no longer valid.",
+             (int)leases);
+    }
+    // Forget the old geometry until the new buffers are in place.
+    buffer_geometry_.reset();
+    if (buffer_policy_.user_memory) {
+        announce_user_memory_(n, payload_bytes);
+    } else {
+        // The producer allocates in this thread. Best effort: it may not
+        // touch the pages here, or may place them itself.
+        const ScopedPreferredNode preferred(
+          resolve_numa_node_(p.numa_node));
+        for (auto& stream : streams_)
+            stream->grabber->reallocBuffers(per_stream);
+        user_memory_.release();
+        if (preferred.is_active())
+            LOG("Preferred NUMA node %d for the producer's buffers",
+                resolve_numa_node_(p.numa_node));
+    }
+    buffer_count_ = n;
+    ++buffer_generation_;
+    buffer_geometry_ = geometry;
+    LOG("Announced %d buffers of %.2f MB (%.2f MB total, %d image(s) per "
+        "buffer, %d data stream(s))",
+        (int)n,
+        1e-6 * (double)payload_bytes,
+        1e-6 * (double)(n * payload_bytes),
+        (int)parts,
+        (int)nstreams);
+}
+
+void
+EGCamera::announce_user_memory_(size_t count, size_t payload_bytes)
+{
+    // Revoke the current buffers before freeing the memory behind them.
+    for (auto& stream : streams_)
+        stream->grabber->reallocBuffers(0);
+    user_memory_.release();
+
+    // Keep each buffer page-aligned.
+    const size_t stride = ((payload_bytes + 4095) / 4096) * 4096;
+    const auto& p = buffer_policy_;
+    const int numa_node = resolve_numa_node_(p.numa_node);
+    const auto t0 = std::chrono::steady_clock::now();
+    user_memory_ = HostMemory::allocate(count * stride,
+                                        {
+                                          .page_bytes = (size_t)p.page_bytes,
+                                          .numa_node = numa_node,
+                                          .lock = p.lock_memory != 0,
+                                        });
+    const std::chrono::duration<double, std::milli> dt =
+      std::chrono::steady_clock::now() - t0;
+
+    // Consecutive slices of the allocation go to each data stream.
+    const size_t per_stream = count / streams_.size();
+    for (size_t i = 0; i < count; ++i) {
+        streams_[i / per_stream]->grabber->announceAndQueue(
+          ES::UserMemory(user_memory_.data() + i * stride, payload_bytes));
+    }
+
+    LOG("Allocated %.2f MB of user memory in %.1f ms. Page size: %d kB "
+        "(requested %d kB). NUMA node: %d (requested %d). Locked: %s.",
+        1e-6 * (double)user_memory_.size(),
+        dt.count(),
+        (int)(user_memory_.page_bytes() >> 10),
+        (int)(p.page_bytes >> 10),
+        user_memory_.numa_node(),
+        numa_node,
+        user_memory_.is_locked() ? "yes" : "no");
+}
+
+double
+EGCamera::estimate_frame_rate_hz_()
+{
+    using namespace Euresys;
+    // Not every camera exposes AcquisitionFrameRate. When it's missing, the
+    // exposure time bounds the frame rate.
+    if (grabber_.getInteger<RemoteModule>(
+          query::available("AcquisitionFrameRate"))) {
+        return grabber_.getFloat<RemoteModule>("AcquisitionFrameRate");
+    }
+    const double exposure_us = features_.get_float("ExposureTime");
+    return exposure_us > 0 ? 1e6 / exposure_us : 0.0;
+}
+
+void
+EGCamera::log_buffering_()
+{
+    // Locking: Expects lock_ to be held by the caller.
+    // Logged on every start: realloc_buffers_() is silent when it reuses the
+    // buffers.
+    if (!buffer_geometry_)
+        return;
+    const auto& g = *buffer_geometry_;
+    const auto& p = buffer_policy_;
+    const double total_mb = 1e-6 * (double)(g.count * g.payload_bytes);
+    char budget[64] = "no budget";
+    if (p.budget_bytes)
+        snprintf(budget,
+                 sizeof(budget),
+                 "a budget of %.2f MB",
+                 1e-6 * (double)p.budget_bytes);
+    const double fps = estimate_frame_rate_hz_();
+    if (fps > 0) {
+        LOG("Buffering %d buffers (%.2f MB, %s): %.3f s at an estimated "
+            "%.1f fps",
+            (int)g.count,
+            total_mb,
+            budget,
+            (double)(g.count * g.images_per_buffer) / fps,
+            fps);
+    } else {
+        LOG("Buffering %d buffers (%.2f MB, %s)",
+            (int)g.count,
+            total_mb,
+            budget);
+    }
+}
+
+size_t
+EGCamera::compute_buffer_count_(size_t payload_bytes)
+{
+    const auto& p = buffer_policy_;
+    const size_t lo = std::max<size_t>(p.min_count, 2);
+    const size_t hi = std::max<size_t>(p.max_count, lo);
+    if (!payload_bytes)
+        return lo;
+
+    const size_t by_budget =
+      p.budget_bytes ? (size_t)(p.budget_bytes / payload_bytes) : hi;
+    size_t n = by_budget;
+    if (p.seconds > 0) {
+        const double fps = estimate_frame_rate_hz_();
+        const double parts = std::max<uint32_t>(p.images_per_buffer, 1);
+        n = std::min(by_budget, (size_t)std::ceil(p.seconds * fps / parts));
+    }
+    if (n < lo) {
+        LOGE("Buffer budget of %.2f MB only fits %d frames of %.2f MB. "
+             "Using the minimum of %d buffers instead.",
+             1e-6 * (double)p.budget_bytes,
+             (int)by_budget,
+             1e-6 * (double)payload_bytes,
+             (int)lo);
+    }
+    return std::clamp(n, lo, hi);
+}
+
+void
+EGCamera::set_buffer_policy(const struct EGrabberBufferPolicy* policy)
+{
+    CHECK(policy);
+    EXPECT(policy->seconds >= 0,
+           "Expected a non-negative buffering time. Got: %f",
+           policy->seconds);
+    EXPECT(!(policy->page_bytes & (policy->page_bytes - 1)),
+           "Expected the page size to be a power of two. Got: %llu bytes",
+           (unsigned long long)policy->page_bytes);
+    const std::scoped_lock lock(lock_);
+    buffer_policy_ = *policy;
+}
+
+void
+EGCamera::get_buffer_policy(struct EGrabberBufferPolicy* policy) const
+{
+    CHECK(policy);
+    const std::scoped_lock lock(lock_);
+    *policy = buffer_policy_;
 }
 
 void
 EGCamera::stop()
 {
+    // Unblock the consumer and the acquisition threads before waiting for
+    // lock_, which set() or a batch of triggers may hold for a while.
+    const auto t0 = std::chrono::steady_clock::now();
+    unblock();
     const std::scoped_lock lock(lock_);
-    grabber_.stop();
-    grabber_.setString<ES::RemoteModule>(echo("TriggerMode"), "Off");
-    grabber_.cancelPop();
+    stop_(t0);
+}
+
+void
+EGCamera::unblock()
+{
+    is_running_ = false;
+    ready_.wake();
+    if (acquisition_mode_ == EGrabberAcquisition_Pop) {
+        for (auto& stream : streams_)
+            stream->grabber->cancelPop();
+    }
+}
+
+void
+EGCamera::stop_(std::chrono::steady_clock::time_point since)
+{
+    // Locking: Expects lock_ to be held by the caller.
+    //
+    // Tears down in order: waiting threads are unblocked, the acquisition
+    // threads joined, the grabbers stopped (the first stream stops the
+    // camera) and the trigger mode restored. Every step runs even if an
+    // earlier one failed. The first failure is rethrown at the end, and
+    // acquiring_ stays set so the next start() stops again.
+    using ms = std::chrono::duration<double, std::milli>;
+    const bool was_running = acquiring_;
+    std::exception_ptr error;
+    const auto attempt = [&error](auto&& step) {
+        try {
+            step();
+        } catch (...) {
+            if (!error)
+                error = std::current_exception();
+        }
+    };
+
+    unblock();
+    const auto t_unblocked = std::chrono::steady_clock::now();
+
+    for (auto& stream : streams_) {
+        if (!stream->thread.joinable())
+            continue;
+        // A cancel that landed between two pops is only seen by the next
+        // one. Cancel again rather than waiting out POP_TIMEOUT_MS.
+        while (stream->receiving) {
+            std::this_thread::sleep_for(
+              std::chrono::microseconds(STOP_CANCEL_INTERVAL_US));
+            if (stream->receiving)
+                attempt([&] { stream->grabber->cancelPop(); });
+        }
+        stream->thread.join();
+    }
+    const auto t_joined = std::chrono::steady_clock::now();
+
+    for (auto& stream : streams_) {
+        attempt([&] { stream->grabber->stop(); });
+        // Wait out a callback that was already handling a buffer. Later ones
+        // see is_running_ cleared and drop theirs.
+        const std::scoped_lock wait(stream->callback_lock);
+    }
+    const auto t_stopped = std::chrono::steady_clock::now();
+
+    attempt([&] { features_.set_string(echo("TriggerMode"), "Off"); });
+    const auto t_done = std::chrono::steady_clock::now();
+
+    stop_unblock_ms_ = ms(t_unblocked - since).count();
+    stop_join_ms_ = ms(t_joined - t_unblocked).count();
+    stop_grabber_ms_ = ms(t_stopped - t_joined).count();
+    stop_settings_ms_ = ms(t_done - t_stopped).count();
+    last_stop_ms_ = ms(t_done - since).count();
+    if (error) {
+        LOGE("Stop failed after %.2f ms. The next start stops again.",
+             last_stop_ms_.load());
+        std::rethrow_exception(error);
+    }
+    acquiring_ = false;
+
+    if (was_running) {
+        LOG("Acquired %llu frames. Lost %llu frames upstream of the driver. "
+            "Frame queue high-water mark: %d/%d. "
+            "Dropped %llu buffers because the queue was full.",
+            (unsigned long long)frames_acquired_.load(),
+            (unsigned long long)frames_lost_.load(),
+            (int)ready_.high_water(),
+            (int)ready_.capacity(),
+            (unsigned long long)ready_.overflows());
+        if (const uint64_t n = triggered_frames_) {
+            LOG("Software trigger to frame latency over %llu frame(s): "
+                "mean %.1f us, max %.1f us",
+                (unsigned long long)n,
+                1e-3 * (double)trigger_latency_sum_ns_ / (double)n,
+                1e-3 * (double)trigger_latency_max_ns_);
+        }
+        if (const uint64_t n = buffers_received_) {
+            LOG("Receive jitter over %llu buffer(s): mean %.1f us, max %.1f "
+                "us. Run queue wait: %.2f ms. Real-time priority: %s.",
+                (unsigned long long)n,
+                1e-3 * (double)receive_jitter_sum_ns_ / (double)n,
+                1e-3 * (double)receive_jitter_max_ns_,
+                1e-6 * (double)run_queue_wait_ns_(),
+                realtime_ ? "yes" : "no");
+        }
+        LOG("Stopped in %.2f ms: unblock %.2f ms, join %.2f ms, grabber "
+            "%.2f ms, settings %.2f ms",
+            last_stop_ms_.load(),
+            stop_unblock_ms_.load(),
+            stop_join_ms_.load(),
+            stop_grabber_ms_.load(),
+            stop_settings_ms_.load());
+    }
+}
+
+void
+EGCamera::acquisition_loop_(size_t stream)
+{
+    auto& s = *streams_[stream];
+    prepare_receiver_(s);
+    while (is_running_) {
+        try {
+            receive_buffer_(stream, s.grabber->pop(POP_TIMEOUT_MS));
+        } catch (const ES::gentl_error& exc) {
+            if (exc.gc_err == ES::gc::GC_ERR_TIMEOUT)
+                continue;
+            // Pops are only cancelled after is_running_ is cleared. One
+            // that's cancelled while running was meant for a previous
+            // acquisition.
+            if (exc.gc_err == ES::gc::GC_ERR_ABORT && is_running_)
+                continue;
+            if (is_running_)
+                LOGE("Acquisition thread: %s", exc.what());
+            break;
+        } catch (const std::exception& exc) {
+            LOGE("Acquisition thread: %s", exc.what());
+            break;
+        }
+    }
+    sample_run_delay_(s, steady_ns());
+    is_running_ = false;
+    ready_.wake();
+    s.receiving = false;
+}
+
+void
+EGCamera::prepare_receiver_(Stream& stream)
+{
+    // Runs on the thread receiving buffers, in the acquisition thread before
+    // it pops the first buffer, or in the first callback after start().
+    if (!thread_cpus_.empty() && !pin_current_thread(thread_cpus_))
+        LOGE("Could not pin the thread receiving buffers");
+    if (receiver_priority_ > 0 || realtime_) {
+        std::string error;
+        if (set_current_thread_priority(receiver_priority_, &error)) {
+            realtime_ = receiver_priority_ > 0;
+            if (realtime_)
+                LOG("Receiving buffers at real-time priority %d",
+                    receiver_priority_);
+        } else {
+            LOGE("Could not set real-time priority %d: %s. Receiving "
+                 "buffers at normal priority.",
+                 receiver_priority_,
+                 error.c_str());
+        }
+    }
+    stream.run_delay_start_ns = current_thread_run_delay_ns();
+    stream.run_delay_sampled_ns = steady_ns();
+    stream.receiver_ready = true;
+}
+
+void
+EGCamera::sample_run_delay_(Stream& stream, uint64_t now_ns)
+{
+    // Runs on the thread receiving the stream's buffers.
+    stream.run_delay_sampled_ns = now_ns;
+    if (!stream.run_delay_start_ns)
+        return;
+    if (const auto run_delay_ns = current_thread_run_delay_ns())
+        stream.run_queue_wait_ns = *run_delay_ns - *stream.run_delay_start_ns;
+}
+
+uint64_t
+EGCamera::run_queue_wait_ns_() const
+{
+    uint64_t total = 0;
+    for (const auto& stream : streams_)
+        total += stream->run_queue_wait_ns;
+    return total;
+}
+
+void
+EGCamera::on_new_buffer_(size_t stream, const ES::NewBufferData& data)
+{
+    // Runs on the stream's callback thread, one buffer at a time. Buffers
+    // that arrive after stop_() are dropped. start() requeues every buffer
+    // anyway.
+    auto& s = *streams_[stream];
+    const std::scoped_lock lock(s.callback_lock);
+    if (!is_running_)
+        return;
+    if (!s.receiver_ready)
+        prepare_receiver_(s);
+    try {
+        receive_buffer_(stream, data);
+        return;
+    } catch (const std::exception& exc) {
+        LOGE("Grabber callback: %s", exc.what());
+    } catch (...) {
+        LOGE("Grabber callback: (unknown)");
+    }
+    is_running_ = false;
+    ready_.wake();
+}
+
+void
+EGCamera::receive_buffer_(size_t stream, const ES::NewBufferData& data)
+{
+    // Called by whichever thread receives the stream's buffers. See
+    // acquisition_mode_.
+    auto& s = *streams_[stream];
+    Frame frame{ .generation = receive_generation_,
+                 .nparts = 1,
+                 .stream = (uint32_t)stream };
+    frame.buffer.emplace(data);
+    frame.frame_id =
+      frame.buffer->getInfo<uint64_t>(ES::gc::BUFFER_INFO_FRAMEID);
+    const uint64_t timestamp_ns =
+      frame.buffer->getInfo<uint64_t>(ES::gc::BUFFER_INFO_TIMESTAMP_NS);
+    if (images_per_buffer_ > 1) {
+        frame.nparts = (uint32_t)frame.buffer->getInfo<size_t>(
+          ES::ge::BUFFER_INFO_CUSTOM_NUM_DELIVERED_PARTS);
+        frame.previous_timestamp_ns = s.last_timestamp_ns;
+        s.last_timestamp_ns = timestamp_ns;
+    }
+
+    // The grabber's clock may be offset from ours. The shortest delay seen
+    // stands in for the time the buffer takes to reach us when this thread
+    // is running. Anything above it is mostly scheduling delay.
+    const uint64_t now_ns = steady_ns();
+    const auto delay_ns = (int64_t)(now_ns - timestamp_ns);
+    s.receive_delay_min_ns = std::min(s.receive_delay_min_ns, delay_ns);
+    const auto jitter_ns = (uint64_t)(delay_ns - s.receive_delay_min_ns);
+    ++buffers_received_;
+    receive_jitter_sum_ns_ += jitter_ns;
+    if (jitter_ns > receive_jitter_max_ns_)
+        receive_jitter_max_ns_ = jitter_ns;
+    if (now_ns - s.run_delay_sampled_ns > RUN_DELAY_SAMPLE_PERIOD_NS)
+        sample_run_delay_(s, now_ns);
+
+    // A gap in the grabber's frame counter means buffers were lost before
+    // they reached us: the grabber had nowhere to write them, or the link
+    // dropped them. Each data stream counts its own buffers.
+    if (s.last_frame_id && frame.frame_id > *s.last_frame_id + 1) {
+        const uint64_t lost =
+          (frame.frame_id - *s.last_frame_id - 1) * images_per_buffer_;
+        if (!frames_lost_)
+            LOGE("Lost %llu frame(s) before frame id %llu",
+                 (unsigned long long)lost,
+                 (unsigned long long)frame.frame_id);
+        frames_lost_ += lost;
+    }
+    s.last_frame_id = frame.frame_id;
+
+    if (streams_.size() == 1) {
+        deliver_(frame);
+        return;
+    }
+
+    // The camera sends its frames to the streams in turn, so frame n of
+    // stream i is frame n * streams + i of the camera. Counted from each
+    // stream's first frame since start(), since the grabbers' counters
+    // needn't agree.
+    if (!s.first_frame_id)
+        s.first_frame_id = frame.frame_id;
+    frame.frame_id =
+      (frame.frame_id - *s.first_frame_id) * streams_.size() + stream;
+    const std::scoped_lock lock(merge_lock_);
+    merge_pending_[stream].push_back(std::move(frame));
+    merge_frames_();
+}
+
+void
+EGCamera::merge_frames_()
+{
+    // Locking: Expects merge_lock_ to be held by the caller.
+    //
+    // The next frame in capture order goes out as soon as it's in, and so
+    // does one that's late. Otherwise the earliest waiting frame goes out
+    // once every stream has one, or a stream has stalled, since the frame
+    // it's waiting for is lost.
+    while (true) {
+        std::deque<Frame>* earliest = nullptr;
+        size_t waiting = 0;
+        bool every_stream = true;
+        for (auto& pending : merge_pending_) {
+            waiting += pending.size();
+            if (pending.empty()) {
+                every_stream = false;
+            } else if (!earliest || pending.front().frame_id <
+                                      earliest->front().frame_id) {
+                earliest = &pending;
+            }
+        }
+        if (!earliest)
+            return;
+        const uint64_t id = earliest->front().frame_id;
+        if (id > merge_next_id_ && !every_stream &&
+            waiting <= merge_pending_.size())
+            return;
+
+        merge_next_id_ = std::max(merge_next_id_, id + 1);
+        Frame frame = std::move(earliest->front());
+        earliest->pop_front();
+        deliver_(frame);
+    }
+}
+
+void
+EGCamera::deliver_(Frame& frame)
+{
+    // Called by the thread receiving buffers, or with several data streams,
+    // by any of them under merge_lock_. Frames arrive in capture order.
+    //
+    // Frames follow software triggers in order. A trigger the camera
+    // ignored makes later latencies look longer until the queue drains.
+    uint64_t triggered_ns;
+    if (trigger_times_.try_pop(triggered_ns)) {
+        const uint64_t dt = steady_ns() - triggered_ns;
+        ++triggered_frames_;
+        trigger_latency_sum_ns_ += dt;
+        if (dt > trigger_latency_max_ns_)
+            trigger_latency_max_ns_ = dt;
+    }
+
+    if (!frame.nparts) {
+        requeue_(frame);
+        return;
+    }
+    frames_acquired_ += frame.nparts;
+
+    if (!ready_.try_push(frame)) {
+        // The consumer has fallen behind. Drop the newest frame and give its
+        // buffer straight back so the grabber never runs dry.
+        frame.buffer->push(*streams_[frame.stream]->grabber);
+    }
+}
+
+enum EGrabberFrameStatus
+EGCamera::next_frame_(uint64_t timeout_ms, Frame* out)
+{
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    while (!ready_.try_pop(*out)) {
+        if (!is_running_)
+            return EGrabberFrame_Stopped;
+
+        // Wait in slices no longer than POP_TIMEOUT_MS.
+        auto wait = milliseconds(POP_TIMEOUT_MS);
+        if (timeout_ms != EGRABBER_INFINITE) {
+            const auto remaining =
+              milliseconds(timeout_ms) -
+              duration_cast<milliseconds>(steady_clock::now() - start);
+            if (remaining <= milliseconds::zero())
+                return EGrabberFrame_Timeout;
+            wait = std::min(wait, remaining);
+        }
+        ready_.wait_for(wait);
+    }
+    return EGrabberFrame_Ok;
+}
+
+enum EGrabberFrameStatus
+EGCamera::next_part_(uint64_t timeout_ms, Part* out)
+{
+    if (!cursor_frame_) {
+        Frame frame;
+        if (const auto ecode = next_frame_(timeout_ms, &frame))
+            return ecode;
+        cursor_frame_ = std::shared_ptr<Frame>(
+          new Frame(std::move(frame)), [this](Frame* f) {
+              requeue_(*f);
+              delete f;
+          });
+        cursor_next_part_ = 0;
+    }
+    *out = { .frame = cursor_frame_, .index = cursor_next_part_++ };
+    if (cursor_next_part_ >= out->frame->nparts)
+        cursor_frame_.reset();
+    return EGrabberFrame_Ok;
+}
+
+void
+EGCamera::requeue_(Frame& frame)
+{
+    // Called from shared_ptr deleters, so this must not throw.
+    try {
+        // Buffers from before the last reallocation have been revoked.
+        if (frame.buffer && frame.generation == buffer_generation_)
+            frame.buffer->push(*streams_[frame.stream]->grabber);
+    } catch (const std::exception& exc) {
+        LOGE("Failed to requeue buffer: %s", exc.what());
+    }
+    frame.buffer.reset();
+}
+
+void
+EGCamera::get_stats(struct EGrabberStats* stats) const
+{
+    CHECK(stats);
+    *stats = {
+        .frames_acquired = frames_acquired_.load(),
+        .frames_lost = frames_lost_.load(),
+        .queue_overflows = ready_.overflows(),
+        .queue_capacity = (uint32_t)ready_.capacity(),
+        .queue_high_water = (uint32_t)ready_.high_water(),
+        .last_configure_ms = last_configure_ms_.load(),
+        .last_start_ms = last_start_ms_.load(),
+        .software_triggers = software_triggers_.load(),
+        .triggered_frames = triggered_frames_.load(),
+        .trigger_latency_mean_us =
+          triggered_frames_ ? 1e-3 * (double)trigger_latency_sum_ns_ /
+                                (double)triggered_frames_
+                            : 0.0,
+        .trigger_latency_max_us = 1e-3 * (double)trigger_latency_max_ns_,
+        .realtime = realtime_,
+        .receive_jitter_mean_us =
+          buffers_received_ ? 1e-3 * (double)receive_jitter_sum_ns_ /
+                                (double)buffers_received_
+                            : 0.0,
+        .receive_jitter_max_us = 1e-3 * (double)receive_jitter_max_ns_,
+        .run_queue_wait_ms = 1e-6 * (double)run_queue_wait_ns_(),
+        .data_streams = (uint32_t)streams_.size(),
+        .last_stop_ms = last_stop_ms_.load(),
+        .stop_unblock_ms = stop_unblock_ms_.load(),
+        .stop_join_ms = stop_join_ms_.load(),
+        .stop_grabber_ms = stop_grabber_ms_.load(),
+        .stop_settings_ms = stop_settings_ms_.load(),
+    };
+}
+
+void
+EGCamera::set_thread_priority(int32_t priority)
+{
+    CHECK(priority >= 0);
+    const std::scoped_lock lock(lock_);
+    thread_priority_ = priority;
+}
+
+void
+EGCamera::refresh(struct CameraProperties* properties)
+{
+    {
+        const std::scoped_lock lock(lock_);
+        stale_meta_ = Meta_All;
+        LOG("Refreshing camera settings. %llu of %llu reads were served "
+            "from the cache.",
+            (unsigned long long)features_.hits(),
+            (unsigned long long)(features_.hits() + features_.reads()));
+        features_.invalidate_all();
+    }
+    struct CameraProperties props = {};
+    get(properties ? properties : &props);
+}
+
+uint32_t
+EGCamera::register_features(const struct EGrabberFeature* features,
+                            uint32_t count,
+                            uint32_t* handles)
+{
+    CHECK(features || !count);
+    CHECK(handles || !count);
+    const std::scoped_lock lock(lock_);
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto& f = features[i];
+        handles[i] = EGRABBER_INVALID_FEATURE;
+        if (!f.name || f.type > EGrabberFeatureType_Command) {
+            LOGE("Feature %u: expected a name and a valid type", i);
+            ++failed;
+            continue;
+        }
+        if (const auto h = feature_registry_.find(f.module, f.name)) {
+            if (feature_registry_.get(*h)->type == f.type) {
+                handles[i] = *h;
+            } else {
+                LOGE("Feature %s was already registered with another type",
+                     f.name);
+                ++failed;
+            }
+            continue;
+        }
+        try {
+            const bool available = with_module(f.module, [&](auto m) {
+                return grabber_.getInteger<MODULE(m)>(
+                         ES::query::available(f.name)) != 0;
+            });
+            if (!available) {
+                LOGE("Feature %s is not available", f.name);
+                ++failed;
+                continue;
+            }
+            handles[i] = feature_registry_.add({
+              .name = f.name,
+              .module = f.module,
+              .type = f.type,
+              .shadowed = is_shadowed_feature(f.module, f.name),
+            });
+        } catch (const std::exception& exc) {
+            LOGE("Failed to register %s: %s", f.name, exc.what());
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+uint32_t
+EGCamera::get_features(struct EGrabberFeatureValue* values, uint32_t count)
+{
+    CHECK(values || !count);
+    const std::scoped_lock lock(lock_);
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& v = values[i];
+        v.status = Device_Err;
+        const auto* f = feature_registry_.get(v.handle);
+        if (!f) {
+            LOGE("Invalid feature handle: %u", v.handle);
+            ++failed;
+            continue;
+        }
+        try {
+            read_feature_(*f, &v);
+            v.status = Device_Ok;
+        } catch (const std::exception& exc) {
+            LOGE("Failed to read %s: %s", f->name.c_str(), exc.what());
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+uint32_t
+EGCamera::set_features(struct EGrabberFeatureValue* values, uint32_t count)
+{
+    CHECK(values || !count);
+    const std::scoped_lock lock(lock_);
+    std::vector<FeatureWrite> shadowed;
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& v = values[i];
+        v.status = Device_Err;
+        const auto* f = feature_registry_.get(v.handle);
+        if (!f) {
+            LOGE("Invalid feature handle: %u", v.handle);
+            ++failed;
+            continue;
+        }
+        try {
+            write_feature_(*f, v, &shadowed);
+            v.status = Device_Ok;
+        } catch (const std::exception& exc) {
+            LOGE("Failed to write %s: %s", f->name.c_str(), exc.what());
+            ++failed;
+        }
+    }
+    invalidate_meta_(shadowed);
+    return failed;
+}
+
+void
+EGCamera::read_feature_(const FeatureRegistry::Entry& feature,
+                        struct EGrabberFeatureValue* value)
+{
+    // Locking: Expects lock_ to be held by the caller.
+    const auto& name = feature.name;
+    switch (feature.type) {
+        case EGrabberFeatureType_Integer:
+            value->integer =
+              feature.shadowed
+                ? features_.get_integer(name)
+                : with_module(feature.module, [&](auto m) {
+                      return grabber_.getInteger<MODULE(m)>(name);
+                  });
+            break;
+        case EGrabberFeatureType_Float:
+            value->number =
+              feature.shadowed
+                ? features_.get_float(name)
+                : with_module(feature.module, [&](auto m) {
+                      return grabber_.getFloat<MODULE(m)>(name);
+                  });
+            break;
+        case EGrabberFeatureType_String: {
+            const auto s = feature.shadowed
+                             ? features_.get_string(name)
+                             : with_module(feature.module, [&](auto m) {
+                                   return grabber_.getString<MODULE(m)>(name);
+                               });
+            EXPECT(s.size() < sizeof(value->string),
+                   "Value of %s is too long: %d bytes",
+                   name.c_str(),
+                   (int)s.size());
+            snprintf(value->string, sizeof(value->string), "%s", s.c_str());
+            break;
+        }
+        case EGrabberFeatureType_Command:
+            throw std::runtime_error("Commands can't be read");
+    }
+}
+
+void
+EGCamera::write_feature_(const FeatureRegistry::Entry& feature,
+                         const struct EGrabberFeatureValue& value,
+                         std::vector<FeatureWrite>* shadowed)
+{
+    // Locking: Expects lock_ to be held by the caller.
+    //
+    // Shadowed features are written through features_ so the shadow copies
+    // stay current. Their names are collected in `shadowed` for
+    // invalidate_meta_().
+    const auto& name = feature.name;
+    switch (feature.type) {
+        case EGrabberFeatureType_Integer:
+            if (feature.shadowed) {
+                features_.set_integer(name, value.integer);
+                shadowed->push_back({ name, value.integer });
+            } else {
+                with_module(feature.module, [&](auto m) {
+                    grabber_.setInteger<MODULE(m)>(name, value.integer);
+                });
+            }
+            break;
+        case EGrabberFeatureType_Float:
+            if (feature.shadowed) {
+                features_.set_float(name, value.number);
+                shadowed->push_back({ name, value.number });
+            } else {
+                with_module(feature.module, [&](auto m) {
+                    grabber_.setFloat<MODULE(m)>(name, value.number);
+                });
+            }
+            break;
+        case EGrabberFeatureType_String: {
+            const std::string s(
+              value.string, strnlen(value.string, sizeof(value.string)));
+            if (feature.shadowed) {
+                features_.set_string(name, s);
+                shadowed->push_back({ name, s });
+            } else {
+                with_module(feature.module, [&](auto m) {
+                    grabber_.setString<MODULE(m)>(name, s);
+                });
+            }
+            break;
+        }
+        case EGrabberFeatureType_Command:
+            with_module(feature.module,
+                        [&](auto m) { grabber_.execute<MODULE(m)>(name); });
+            break;
+    }
 }
 
 void
 EGCamera::get_shape(struct ImageShape* shape) const
 {
     const std::scoped_lock lock(lock_);
-    uint32_t w = grabber_.getWidth();
-    uint32_t h = grabber_.getHeight();
+    if (is_running_) {
+        *shape = layout_.info.shape;
+        return;
+    }
+    uint32_t w = (uint32_t)features_.get_integer("Width");
+    uint32_t h = (uint32_t)features_.get_integer("Height");
 
     *shape = {
         .dims = {
@@ -790,64 +2884,497 @@ EGCamera::get_shape(struct ImageShape* shape) const
           .height = w,
           .planes = w*h,
         },
-        .type = at_or(px_type_table_,grabber_.getString<ES::RemoteModule>("PixelFormat"),SampleType_Unknown),
+        .type = at_or(px_type_table_,features_.get_string("PixelFormat"),SampleType_Unknown),
     };
 }
 void
-EGCamera::execute_trigger() const
+EGCamera::execute_trigger()
 {
     const std::scoped_lock lock(lock_);
-    auto source = grabber_.getString<ES::RemoteModule>("TriggerSource");
-    grabber_.setString<ES::RemoteModule>("TriggerSource", "Software");
-    grabber_.execute<ES::RemoteModule>("TriggerSoftware");
-    grabber_.setString<ES::RemoteModule>("TriggerSource", source);
+    fire_trigger_();
+}
+
+void
+EGCamera::fire_triggers(uint32_t count, uint64_t interval_us)
+{
+    // lock_ is released between triggers so stop() and get() aren't held
+    // up for the whole batch. The batch ends early if acquisition stops.
+    using namespace std::chrono;
+    const bool was_running = is_running_;
+    auto next = steady_clock::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i) {
+            next += microseconds(interval_us);
+            std::this_thread::sleep_until(next);
+            if (was_running && !is_running_)
+                break;
+        }
+        const std::scoped_lock lock(lock_);
+        fire_trigger_();
+    }
+}
+
+void
+EGCamera::fire_trigger_()
+{
+    // Locking: Expects lock_ to be held by the caller.
+    //
+    // TriggerSource comes from the shadow copy. When it's already Software,
+    // as it is for software-triggered acquisition, this is one command on
+    // the control link. Otherwise the source is switched for the trigger and
+    // put back afterwards.
+    const auto source = features_.get_string("TriggerSource");
+    const bool swap = source != "Software";
+    if (swap)
+        features_.set_string("TriggerSource", "Software");
+
+    // Only triggers that produce a frame are matched with one, and only in
+    // software-triggered acquisition, where every frame follows one. With
+    // another source, the frames it triggers can't be told apart. The time
+    // is queued first since the frame can arrive before execute() returns.
+    uint64_t t0 = steady_ns();
+    if (!swap && is_running_ && features_.get_string("TriggerMode") == "On")
+        trigger_times_.try_push(t0);
+    try {
+        grabber_.execute<ES::RemoteModule>("TriggerSoftware");
+    } catch (...) {
+        if (swap)
+            features_.set_string("TriggerSource", source);
+        throw;
+    }
+    ++software_triggers_;
+
+    if (swap)
+        features_.set_string("TriggerSource", source);
+}
+
+void
+EGCamera::describe_part_(const Part& part,
+                         const void** data,
+                         size_t* nbytes,
+                         struct ImageInfo* info)
+{
+    const auto& frame = *part.frame;
+    const auto& buffer = *frame.buffer;
+
+    const auto* base = buffer.getInfo<void*>(ES::gc::BUFFER_INFO_BASE);
+    EXPECT(base, "Expected non-null pointer");
+    auto timestamp_ns =
+      buffer.getInfo<uint64_t>(ES::gc::BUFFER_INFO_TIMESTAMP_NS);
+
+    if (images_per_buffer_ > 1) {
+        // The grabber timestamps buffers, not the images in them. Spread the
+        // images evenly between the previous buffer and this one.
+        const auto t0 = frame.previous_timestamp_ns;
+        if (t0 && t0 < timestamp_ns) {
+            timestamp_ns =
+              t0 + (timestamp_ns - t0) * (part.index + 1) / frame.nparts;
+        }
+    }
+
+    // Images in a multi-image buffer are numbered consecutively.
+    layout_.describe(base,
+                     part.index,
+                     timestamp_ns,
+                     frame.frame_id * images_per_buffer_ + part.index,
+                     data,
+                     nbytes,
+                     info);
 }
 
 void
 EGCamera::get_frame(void* im, size_t* nbytes, struct ImageInfo* info)
+{
+    // Blocks until the acquisition thread has a frame or the configured
+    // timeout elapses. Without a timeout this could block for an
+    // indeterminate amount of time, e.g. when waiting on an external
+    // trigger. stop() always unblocks it.
+    switch (try_get_frame(im, nbytes, info, frame_timeout_ms_)) {
+        case EGrabberFrame_Ok:
+            return;
+        case EGrabberFrame_Timeout:
+            throw std::runtime_error("Timed out waiting for a frame.");
+        default:
+            throw std::runtime_error("Acquisition is not running.");
+    }
+}
+
+enum EGrabberFrameStatus
+EGCamera::try_get_frame(void* im,
+                        size_t* nbytes,
+                        struct ImageInfo* info,
+                        uint64_t timeout_ms)
 {
     // Locking: This function is basically read-only when it comes to EGCamera
-    // state so it doesn't need a scoped lock.
+    // state so it doesn't need a scoped lock. It is the consumer side of
+    // ready_, so get_frame() and lease_frame() must not be called
+    // concurrently.
+    CHECK(im);
+    CHECK(nbytes);
+    CHECK(info);
+
+    // The buffer is requeued when the last image in it is done.
+    Part part;
+    if (const auto ecode = next_part_(timeout_ms, &part))
+        return ecode;
+
+    const void* data = nullptr;
+    size_t size = 0;
+    describe_part_(part, &data, &size, info);
+    if (layout_.packing == PixelPacking::None) {
+        CHECK(*nbytes >= size);
+        copier_.copy(im, data, size);
+    } else {
+        // Unpacked on the way out of the DMA buffer.
+        size = layout_.image_bytes;
+        CHECK(*nbytes >= size);
+        copier_.unpack(
+          (uint16_t*)im, data, layout_.pixel_count(), layout_.packing);
+    }
+    *nbytes = size;
+    return EGrabberFrame_Ok;
+}
 
-    // Instancing the buffer blocks until the camera acquires the next
-    // frame. This could block for an indeterminate amount of time, e.g. when
-    // waiting on an external trigger.
-    Euresys::ScopedBuffer buffer(grabber_);
+void
+EGCamera::lease_frame(struct EGrabberFrameLease* lease)
+{
+    // Blocks like get_frame().
+    switch (try_lease_frame(lease, frame_timeout_ms_)) {
+        case EGrabberFrame_Ok:
+            return;
+        case EGrabberFrame_Timeout:
+            throw std::runtime_error("Timed out waiting for a frame.");
+        default:
+            throw std::runtime_error("Acquisition is not running.");
+    }
+}
 
-    const auto timestamp_ns =
-      buffer.getInfo<uint64_t>(ES::gc::BUFFER_INFO_TIMESTAMP_NS);
-    const auto height = buffer.getInfo<size_t>(ES::gc::BUFFER_INFO_HEIGHT);
+enum EGrabberFrameStatus
+EGCamera::try_lease_frame(struct EGrabberFrameLease* lease,
+                          uint64_t timeout_ms)
+{
+    // Locking: Same as get_frame(). The lease count is atomic.
+    CHECK(lease);
+
+    // At least one buffer per data stream has to remain with the grabber or
+    // acquisition stalls. The lease is reserved before taking a frame, so
+    // concurrent callers can't both take the last one, and given back if no
+    // frame comes.
+    size_t leases = outstanding_leases_.load();
+    do {
+        EXPECT(leases + streams_.size() < buffer_count_.load(),
+               "Too many outstanding frame leases (%d). Release some first.",
+               (int)leases);
+    } while (!outstanding_leases_.compare_exchange_weak(leases, leases + 1));
+
+    Part part;
+    enum EGrabberFrameStatus ecode;
+    try {
+        ecode = next_part_(timeout_ms, &part);
+    } catch (...) {
+        --outstanding_leases_;
+        throw;
+    }
+    if (ecode != EGrabberFrame_Ok) {
+        --outstanding_leases_;
+        return ecode;
+    }
+    auto* handle = new Part(std::move(part));
 
-    auto buf_info = buffer.getInfo();
-    CHECK(*nbytes >= buf_info.size);
-    EXPECT(buf_info.base, "Expected non-null pointer");
+    try {
+        *lease = { .handle = handle };
+        describe_part_(*handle, &lease->data, &lease->nbytes, &lease->info);
+        static_assert((int)PixelPacking::Mono10p ==
+                        EGrabberPixelPacking_Mono10p &&
+                      (int)PixelPacking::Mono12p ==
+                        EGrabberPixelPacking_Mono12p);
+        lease->packing = (EGrabberPixelPacking)layout_.packing;
+    } catch (...) {
+        release_frame(lease);
+        throw;
+    }
+    return EGrabberFrame_Ok;
+}
 
-    if (buf_info.deliveredHeight != height) {
-        LOGE("Delivered height and height are different: %d != %d",
-             (int)buf_info.deliveredHeight,
-             (int)height);
+void
+EGCamera::release_frame(struct EGrabberFrameLease* lease)
+{
+    CHECK(lease);
+    EXPECT(lease->handle, "Frame lease was not acquired or already released.");
+    auto* handle = (Part*)lease->handle;
+    *lease = {};
+    // Requeues the buffer if this was the last image in it still in use.
+    delete handle;
+    --outstanding_leases_;
+}
+
+//
+//      EGGROUP IMPLEMENTATION
+//
+
+EGGroup::EGGroup(std::vector<EGCamera*> cameras,
+                 const struct EGrabberGroupConfig& config)
+  : cameras_(std::move(cameras))
+  , config_(config)
+  , tolerance_ns_((uint64_t)(1e3 * (config.timestamp_tolerance_us > 0
+                                      ? config.timestamp_tolerance_us
+                                      : 1000.0)))
+  , heads_(cameras_.size())
+  , first_frame_ids_(cameras_.size())
+  , runs_(0)
+  , frame_sets_(0)
+  , unmatched_frames_(0)
+  , misaligned_sets_(0)
+  , set_skew_max_ns_(0)
+  , start_skew_ms_(0)
+  , running_(false)
+{
+    EXPECT(!cameras_.empty(), "Expected at least one camera");
+    EXPECT(config.alignment == EGrabberGroupAlignment_FrameId ||
+             config.alignment == EGrabberGroupAlignment_Timestamp,
+           "Unknown frame alignment: %d",
+           (int)config.alignment);
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+        CHECK(cameras_[i]);
+        if (!cameras_[i]->join_group()) {
+            for (size_t j = 0; j < i; ++j)
+                cameras_[j]->leave_group();
+            throw std::runtime_error("Camera " + std::to_string(i) +
+                                     " already belongs to a group");
+        }
     }
+    LOG("Grouped %d camera(s). Frames are matched by %s.",
+        (int)cameras_.size(),
+        config.alignment == EGrabberGroupAlignment_FrameId ? "frame id"
+                                                           : "timestamp");
+}
 
-    std::memcpy(im, buf_info.base, buf_info.size);
-    *info = {
-        .shape = {
-              .dims = { .channels = 1,
-                        .width = (uint32_t)buf_info.width,
-                        .height = (uint32_t)height,
-                        .planes = 1 },
-              .strides = { .channels = 1,
-                           .width = 1,
-                           .height = (int64_t)buf_info.width,
-                           .planes = (int64_t)(buf_info.width * height),
-              },
-              .type = at_or(px_type_table_, buf_info.pixelFormat,
-              SampleType_Unknown),
-          },
-          .hardware_timestamp = timestamp_ns,
-          .hardware_frame_id = frame_id_++,
+EGGroup::~EGGroup()
+{
+    try {
+        stop();
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    for (auto* camera : cameras_)
+        camera->leave_group();
+}
+
+void
+EGGroup::start()
+{
+    const std::scoped_lock lock(lock_);
+    release_heads_();
+    std::fill(first_frame_ids_.begin(), first_frame_ids_.end(), std::nullopt);
+    ++runs_;
+    frame_sets_ = 0;
+    unmatched_frames_ = 0;
+    misaligned_sets_ = 0;
+    set_skew_max_ns_ = 0;
+
+    if (config_.frame_start.enable) {
+        run_in_parallel(cameras_.size(), [this](size_t i) {
+            struct CameraProperties props = {};
+            cameras_[i]->get(&props);
+            props.input_triggers.frame_start = config_.frame_start;
+            cameras_[i]->set(&props);
+        });
+    }
+
+    // Started in parallel so the last camera isn't armed long after the
+    // first. Start includes any buffer reallocation.
+    using namespace std::chrono;
+    std::vector<steady_clock::time_point> started(cameras_.size());
+    try {
+        run_in_parallel(cameras_.size(), [&](size_t i) {
+            cameras_[i]->start();
+            started[i] = steady_clock::now();
+        });
+    } catch (...) {
+        run_in_parallel(cameras_.size(),
+                        [this](size_t i) { cameras_[i]->stop(); });
+        throw;
+    }
+    running_ = true;
+    const auto [first, last] =
+      std::minmax_element(started.begin(), started.end());
+    start_skew_ms_ = duration<double, std::milli>(*last - *first).count();
+    LOG("Started %d camera(s). Start skew: %.2f ms.",
+        (int)cameras_.size(),
+        start_skew_ms_);
+}
+
+void
+EGGroup::stop()
+{
+    // Release a consumer waiting in get_frame_set() before waiting for
+    // lock_. It then finds the group stopped once it gets lock_ back.
+    for (auto* camera : cameras_)
+        camera->unblock();
+    const std::scoped_lock lock(lock_);
+    release_heads_();
+    run_in_parallel(cameras_.size(), [this](size_t i) { cameras_[i]->stop(); });
+    if (running_) {
+        running_ = false;
+        LOG("Returned %llu frame set(s). Released %llu unmatched frame(s). "
+            "Largest timestamp spread within a set: %.1f us.",
+            (unsigned long long)frame_sets_,
+            (unsigned long long)unmatched_frames_,
+            1e-3 * (double)set_skew_max_ns_);
+        if (misaligned_sets_)
+            LOGE("%llu frame set(s) matched by frame id were further apart "
+                 "than %.1f us.",
+                 (unsigned long long)misaligned_sets_,
+                 1e-3 * (double)tolerance_ns_);
+    }
+}
+
+void
+EGGroup::execute_trigger()
+{
+    const std::scoped_lock lock(lock_);
+    run_in_parallel(cameras_.size(),
+                    [this](size_t i) { cameras_[i]->execute_trigger(); });
+}
+
+enum EGrabberFrameStatus
+EGGroup::get_frame_set(struct EGrabberFrameLease* leases, uint64_t timeout_ms)
+{
+    using namespace std::chrono;
+    CHECK(leases);
+    std::unique_lock lock(lock_);
+    if (!running_)
+        return EGrabberFrame_Stopped;
+    const uint64_t run = runs_;
+
+    // Timeouts too long to be added to the clock wait forever.
+    const auto now = steady_clock::now();
+    const auto longest =
+      duration_cast<milliseconds>(steady_clock::time_point::max() - now);
+    const bool finite = timeout_ms != EGRABBER_INFINITE &&
+                        timeout_ms < (uint64_t)longest.count();
+    const auto deadline = finite ? now + milliseconds(timeout_ms)
+                                 : steady_clock::time_point::max();
+    while (true) {
+        // Frames already leased wait in heads_ for the others, even across
+        // calls that time out.
+        for (size_t i = 0; i < cameras_.size(); ++i) {
+            if (heads_[i])
+                continue;
+            uint64_t remaining_ms = EGRABBER_INFINITE;
+            if (finite) {
+                const auto now = steady_clock::now();
+                remaining_ms =
+                  now < deadline
+                    ? (uint64_t)duration_cast<milliseconds>(deadline - now)
+                        .count()
+                    : 0;
+            }
+
+            // Wait without lock_, so the group can be stopped or triggered
+            // meanwhile. stop() unblocks the wait.
+            struct EGrabberFrameLease lease = {};
+            lock.unlock();
+            const auto ecode =
+              cameras_[i]->try_lease_frame(&lease, remaining_ms);
+            lock.lock();
+            if (ecode)
+                return ecode;
+            if (!running_ || runs_ != run) {
+                cameras_[i]->release_frame(&lease);
+                return EGrabberFrame_Stopped;
+            }
+            heads_[i] = lease;
+            if (!first_frame_ids_[i])
+                first_frame_ids_[i] = lease.info.hardware_frame_id;
+        }
+
+        // Frames behind the latest one can't be part of a set any more.
+        int64_t latest = INT64_MIN;
+        for (size_t i = 0; i < cameras_.size(); ++i)
+            latest = std::max(latest, key_(i));
+        const int64_t tolerance =
+          config_.alignment == EGrabberGroupAlignment_Timestamp
+            ? (int64_t)tolerance_ns_
+            : 0;
+        bool matched = true;
+        for (size_t i = 0; i < cameras_.size(); ++i) {
+            if (key_(i) + tolerance < latest) {
+                cameras_[i]->release_frame(&*heads_[i]);
+                heads_[i].reset();
+                ++unmatched_frames_;
+                matched = false;
+            }
+        }
+        if (!matched)
+            continue;
+
+        uint64_t t0 = UINT64_MAX, t1 = 0;
+        for (size_t i = 0; i < cameras_.size(); ++i) {
+            leases[i] = *heads_[i];
+            heads_[i].reset();
+            t0 = std::min(t0, leases[i].info.hardware_timestamp);
+            t1 = std::max(t1, leases[i].info.hardware_timestamp);
+        }
+        ++frame_sets_;
+        set_skew_max_ns_ = std::max(set_skew_max_ns_, t1 - t0);
+        if (config_.alignment == EGrabberGroupAlignment_FrameId &&
+            t1 - t0 > tolerance_ns_ && !misaligned_sets_++)
+            LOGE("Frames matched by frame id are %.1f us apart. A camera may "
+                 "have missed the first trigger after start, which offsets "
+                 "every set.",
+                 1e-3 * (double)(t1 - t0));
+        return EGrabberFrame_Ok;
+    }
+}
+
+void
+EGGroup::release_frame_set(struct EGrabberFrameLease* leases)
+{
+    CHECK(leases);
+    for (size_t i = 0; i < cameras_.size(); ++i)
+        if (leases[i].handle)
+            cameras_[i]->release_frame(&leases[i]);
+}
+
+void
+EGGroup::get_stats(struct EGrabberGroupStats* stats) const
+{
+    CHECK(stats);
+    const std::scoped_lock lock(lock_);
+    *stats = {
+        .frame_sets = frame_sets_,
+        .unmatched_frames = unmatched_frames_,
+        .set_skew_max_us = 1e-3 * (double)set_skew_max_ns_,
+        .start_skew_ms = start_skew_ms_,
     };
 }
 
+int64_t
+EGGroup::key_(size_t i) const
+{
+    // Locking: Expects lock_ to be held by the caller, and heads_[i] to be
+    // set.
+    const auto& info = heads_[i]->info;
+    if (config_.alignment == EGrabberGroupAlignment_Timestamp)
+        return (int64_t)info.hardware_timestamp;
+    return (int64_t)(info.hardware_frame_id - *first_frame_ids_[i]);
+}
+
+void
+EGGroup::release_heads_()
+{
+    // Locking: Expects lock_ to be held by the caller.
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+        if (heads_[i]) {
+            cameras_[i]->release_frame(&*heads_[i]);
+            heads_[i].reset();
+        }
+    }
+}
+
 //
 //      EGDRIVER IMPLEMENTATION
 //
@@ -860,47 +3387,100 @@ EGDriver::EGDriver()
       .close = ::eecam_close,
       .shutdown = ::eecam_shutdown_,
   }
+  , discovery_ttl_(default_discovery_ttl_s())
+  , acquisition_mode_(default_acquisition_mode())
 {
 }
 
-void
-EGDriver::describe(DeviceIdentifier* identifier, uint64_t i)
+const EGDriver::Snapshot&
+EGDriver::snapshot_locked_()
 {
+    // Locking: Expects lock_ to be held by the caller.
+    const auto now = std::chrono::steady_clock::now();
+    if (snapshot_ && now - snapshot_->taken < discovery_ttl_)
+        return *snapshot_;
+
     ES::EGrabberDiscovery discovery(gentl_);
     discovery.discover();
 
+    Snapshot snapshot{ .taken = now };
+    const int n = discovery.cameraCount();
+    for (int i = 0; i < n; ++i)
+        snapshot.cameras.push_back(discovery.cameras(i));
+    snapshot.names.resize(snapshot.cameras.size());
+    snapshot_ = std::move(snapshot);
+
+    const std::chrono::duration<double, std::milli> dt =
+      std::chrono::steady_clock::now() - now;
+    LOG("Discovered %d camera(s) in %.1f ms", n, dt.count());
+    return *snapshot_;
+}
+
+void
+EGDriver::refresh_discovery()
+{
+    const std::scoped_lock lock(lock_);
+    snapshot_.reset();
+    snapshot_locked_();
+}
+
+void
+EGDriver::set_acquisition_mode(enum EGrabberAcquisitionMode mode)
+{
+    EXPECT(mode == EGrabberAcquisition_Pop ||
+             mode == EGrabberAcquisition_Callback,
+           "Unknown acquisition mode: %d",
+           (int)mode);
+    const std::scoped_lock lock(lock_);
+    acquisition_mode_ = mode;
+}
+
+void
+EGDriver::describe(DeviceIdentifier* identifier, uint64_t i)
+{
     // EGrabber api expects an int32
     // DeviceManager device_id expects a uint8
     EXPECT(i < (1 << 8), "Expected a uint8 device index. Got: %llu", i);
 
-    Euresys::EGrabber<> grabber(discovery.cameras((int)i));
-
-    const auto vendor_name =
-      grabber.getString<Euresys::RemoteModule>("DeviceVendorName");
-    const auto device_name =
-      grabber.getString<Euresys::RemoteModule>("DeviceModelName");
-    const auto device_sn =
-      grabber.getString<Euresys::RemoteModule>("DeviceSerialNumber");
+    const std::scoped_lock lock(lock_);
+    const auto& snapshot = snapshot_locked_();
+    EXPECT(i < snapshot.cameras.size(),
+           "Expected a device index less than %d. Got: %llu",
+           (int)snapshot.cameras.size(),
+           i);
+
+    auto& name = snapshot_->names[i];
+    if (!name) {
+        const auto t0 = std::chrono::steady_clock::now();
+        Euresys::EGrabber<> grabber(snapshot.cameras[i]);
+
+        const auto vendor_name =
+          grabber.getString<Euresys::RemoteModule>("DeviceVendorName");
+        const auto device_name =
+          grabber.getString<Euresys::RemoteModule>("DeviceModelName");
+        const auto device_sn =
+          grabber.getString<Euresys::RemoteModule>("DeviceSerialNumber");
+        name = vendor_name + " " + device_name + " " + device_sn;
+
+        const std::chrono::duration<double, std::milli> dt =
+          std::chrono::steady_clock::now() - t0;
+        LOG("Read the identity of camera %d in %.1f ms", (int)i, dt.count());
+    }
 
     *identifier = DeviceIdentifier{
         .device_id = (uint8_t)i,
         .kind = DeviceKind_Camera,
     };
 
-    snprintf(identifier->name,
-             sizeof(identifier->name),
-             "%s %s %s",
-             vendor_name.c_str(),
-             device_name.c_str(),
-             device_sn.c_str());
+    snprintf(
+      identifier->name, sizeof(identifier->name), "%s", name->c_str());
 }
 
 uint32_t
 EGDriver::device_count()
 {
-    ES::EGrabberDiscovery discovery(gentl_);
-    discovery.discover();
-    return discovery.cameraCount();
+    const std::scoped_lock lock(lock_);
+    return (uint32_t)snapshot_locked_().cameras.size();
 }
 
 void
@@ -911,10 +3491,20 @@ EGDriver::open(uint64_t device_id, struct Device** out)
            "Expected an int32 device id. Got: %llu",
            device_id);
 
-    Euresys::EGrabberDiscovery discovery(gentl_);
-    discovery.discover();
+    ES::EGrabberCameraInfo info;
+    enum EGrabberAcquisitionMode mode;
+    {
+        const std::scoped_lock lock(lock_);
+        const auto& snapshot = snapshot_locked_();
+        EXPECT(device_id < snapshot.cameras.size(),
+               "Expected a device id less than %d. Got: %llu",
+               (int)snapshot.cameras.size(),
+               device_id);
+        info = snapshot.cameras[device_id];
+        mode = acquisition_mode_;
+    }
 
-    *out = (Device*)new EGCamera(discovery.cameras((int)device_id));
+    *out = (Device*)new EGCamera(info, mode);
 }
 
 void
@@ -922,9 +3512,24 @@ EGDriver::close(struct Device* in)
 {
     CHECK(in);
     auto camera = (EGCamera*)in;
+    EXPECT(!camera->is_grouped(),
+           "Camera belongs to a group. Destroy the group first.");
     delete camera;
 }
 
+EGGroup*
+EGDriver::create_group(struct Camera* const* cameras,
+                       uint32_t count,
+                       const struct EGrabberGroupConfig* config)
+{
+    CHECK(cameras);
+    CHECK(config);
+    std::vector<EGCamera*> members;
+    for (uint32_t i = 0; i < count; ++i)
+        members.push_back((EGCamera*)cameras[i]);
+    return new EGGroup(std::move(members), *config);
+}
+
 } // end anonymous namespace
 
 acquire_export struct Driver*
@@ -932,6 +3537,9 @@ acquire_driver_init_v0(acquire_reporter_t reporter)
 {
     try {
         logger_set_reporter(reporter);
+#ifdef ACQUIRE_EGRABBER_SIMULATED
+        LOG("Built against the simulated eGrabber. Cameras are simulated.");
+#endif
         return new EGDriver;
     } catch (const std::exception& exc) {
         LOGE("Exception: %s\n", exc.what());
@@ -941,5 +3549,255 @@ acquire_driver_init_v0(acquire_reporter_t reporter)
     return nullptr;
 }
 
+acquire_export enum DeviceStatusCode
+egrabber_driver_refresh_discovery(struct Driver* driver)
+{
+    try {
+        CHECK(driver);
+        ((struct EGDriver*)driver)->refresh_discovery();
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_driver_set_acquisition_mode(struct Driver* driver,
+                                     enum EGrabberAcquisitionMode mode)
+{
+    try {
+        CHECK(driver);
+        ((struct EGDriver*)driver)->set_acquisition_mode(mode);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_driver_create_group(struct Driver* driver,
+                             struct Camera* const* cameras,
+                             uint32_t count,
+                             const struct EGrabberGroupConfig* config,
+                             struct EGrabberGroup** group)
+{
+    try {
+        CHECK(driver);
+        CHECK(group);
+        *group = (struct EGrabberGroup*)((struct EGDriver*)driver)
+                   ->create_group(cameras, count, config);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_group_destroy(struct EGrabberGroup* group)
+{
+    try {
+        CHECK(group);
+        delete (EGGroup*)group;
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_group_start(struct EGrabberGroup* group)
+{
+    try {
+        CHECK(group);
+        ((EGGroup*)group)->start();
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_group_stop(struct EGrabberGroup* group)
+{
+    try {
+        CHECK(group);
+        ((EGGroup*)group)->stop();
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_group_execute_trigger(struct EGrabberGroup* group)
+{
+    try {
+        CHECK(group);
+        ((EGGroup*)group)->execute_trigger();
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum EGrabberFrameStatus
+egrabber_group_get_frame_set(struct EGrabberGroup* group,
+                             struct EGrabberFrameLease* leases,
+                             uint64_t timeout_ms)
+{
+    try {
+        CHECK(group);
+        return ((EGGroup*)group)->get_frame_set(leases, timeout_ms);
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return EGrabberFrame_Error;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_group_release_frame_set(struct EGrabberGroup* group,
+                                 struct EGrabberFrameLease* leases)
+{
+    try {
+        CHECK(group);
+        ((EGGroup*)group)->release_frame_set(leases);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_group_get_stats(const struct EGrabberGroup* group,
+                         struct EGrabberGroupStats* stats)
+{
+    try {
+        CHECK(group);
+        ((const EGGroup*)group)->get_stats(stats);
+        return Device_Ok;
+    } catch (const std::exception& exc) {
+        LOGE("Exception: %s\n", exc.what());
+    } catch (...) {
+        LOGE("Exception: (unknown)");
+    }
+    return Device_Err;
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_lease_frame(struct Camera* camera,
+                            struct EGrabberFrameLease* lease)
+{
+    return eecam_lease_frame(camera, lease);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_release_frame(struct Camera* camera,
+                              struct EGrabberFrameLease* lease)
+{
+    return eecam_release_frame(camera, lease);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_set_buffer_policy(struct Camera* camera,
+                                  const struct EGrabberBufferPolicy* policy)
+{
+    return eecam_set_buffer_policy(camera, policy);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_get_buffer_policy(const struct Camera* camera,
+                                  struct EGrabberBufferPolicy* policy)
+{
+    return eecam_get_buffer_policy(camera, policy);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_get_stats(const struct Camera* camera,
+                          struct EGrabberStats* stats)
+{
+    return eecam_get_stats(camera, stats);
+}
+
+acquire_export enum EGrabberFrameStatus
+egrabber_camera_try_get_frame(struct Camera* camera,
+                              void* im,
+                              size_t* nbytes,
+                              struct ImageInfo* info,
+                              uint64_t timeout_ms)
+{
+    return eecam_try_get_frame(camera, im, nbytes, info, timeout_ms);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_refresh_properties(struct Camera* camera,
+                                   struct CameraProperties* properties)
+{
+    return eecam_refresh_properties(camera, properties);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_fire_triggers(struct Camera* camera,
+                              uint32_t count,
+                              uint64_t interval_us)
+{
+    return eecam_fire_triggers(camera, count, interval_us);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_set_thread_priority(struct Camera* camera, int32_t priority)
+{
+    return eecam_set_thread_priority(camera, priority);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_register_features(struct Camera* camera,
+                                  const struct EGrabberFeature* features,
+                                  uint32_t count,
+                                  uint32_t* handles)
+{
+    return eecam_register_features(camera, features, count, handles);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_get_features(struct Camera* camera,
+                             struct EGrabberFeatureValue* values,
+                             uint32_t count)
+{
+    return eecam_get_features(camera, values, count);
+}
+
+acquire_export enum DeviceStatusCode
+egrabber_camera_set_features(struct Camera* camera,
+                             struct EGrabberFeatureValue* values,
+                             uint32_t count)
+{
+    return eecam_set_features(camera, values, count);
+}
+
 // TODO: (nclack) use BufferInfo in get_shape?
-// TODO: (nclack) Timestamp and frame id
@@ -0,0 +1,528 @@
+/// @file Extensions exported by the eGrabber driver beyond the device kit's
+/// `Camera` interface.
+///
+/// These are reached by loading the driver module directly (see
+/// `tests/lease-frames.cpp`) and resolving the symbols with `lib_load`. The
+/// `Camera*` arguments are the devices returned by the driver's `open`.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_V0
+
+#include "device/kit/camera.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Timeout value meaning "wait forever".
+#define EGRABBER_INFINITE (0xFFFFFFFFFFFFFFFFULL)
+
+    struct Driver;
+
+    /// The driver reuses the result of its last device discovery for
+    /// `ACQUIRE_EGRABBER_DISCOVERY_TTL_S` seconds (default 5), along with
+    /// the device names returned by `describe`. Call this after plugging in
+    /// or removing a camera to discover again right away. `driver` is the
+    /// one returned by `acquire_driver_init_v0`.
+    enum DeviceStatusCode egrabber_driver_refresh_discovery(
+      struct Driver* driver);
+
+    /// How filled buffers get from the grabber to the driver's frame queue.
+    enum EGrabberAcquisitionMode
+    {
+        /// A driver thread pops each buffer from the grabber.
+        EGrabberAcquisition_Pop = 0,
+        /// The grabber hands each buffer to the driver on its own callback
+        /// thread as soon as it's filled (`CallbackMultiThread`). Saves a
+        /// thread wake-up per buffer.
+        EGrabberAcquisition_Callback,
+    };
+
+    /// Selects the acquisition mode of cameras opened after this call. The
+    /// mode can't change while a camera is open. Defaults to
+    /// `EGrabberAcquisition_Callback` when `ACQUIRE_EGRABBER_CALLBACKS` is
+    /// non-zero, otherwise `EGrabberAcquisition_Pop`.
+    enum DeviceStatusCode egrabber_driver_set_acquisition_mode(
+      struct Driver* driver,
+      enum EGrabberAcquisitionMode mode);
+
+    enum EGrabberFrameStatus
+    {
+        EGrabberFrame_Ok = 0,
+        /// No frame arrived before the timeout.
+        EGrabberFrame_Timeout,
+        /// The camera isn't acquiring, or was stopped while waiting.
+        EGrabberFrame_Stopped,
+        /// Anything else. Details are logged.
+        EGrabberFrame_Error,
+    };
+
+    /// Like the kit's `get_frame`, but waits at most `timeout_ms` for the
+    /// next frame and reports why no frame was returned instead of failing.
+    /// A timeout of 0 polls. On success, `*nbytes` is set to the frame size.
+    enum EGrabberFrameStatus egrabber_camera_try_get_frame(
+      struct Camera* camera,
+      void* im,
+      size_t* nbytes,
+      struct ImageInfo* info,
+      uint64_t timeout_ms);
+
+    /// Layout of the pixels in a leased frame.
+    enum EGrabberPixelPacking
+    {
+        /// One pixel per 8- or 16-bit container, as described by `info`.
+        EGrabberPixelPacking_None = 0,
+        /// GenICam Mono10p: 4 pixels in 5 bytes, LSB first.
+        EGrabberPixelPacking_Mono10p,
+        /// GenICam Mono12p: 2 pixels in 3 bytes, LSB first.
+        EGrabberPixelPacking_Mono12p,
+    };
+
+    /// A frame borrowed directly from one of the grabber's DMA buffers.
+    ///
+    /// `data` points into memory owned by the grabber and stays valid until
+    /// the lease is handed back with `egrabber_camera_release_frame()`. Until
+    /// then the buffer is not available to the grabber for acquisition, so
+    /// leases should be short-lived.
+    ///
+    /// Leases aren't unpacked. When `packing` isn't
+    /// `EGrabberPixelPacking_None`, `data` holds `nbytes` of packed pixels
+    /// while `info` describes the unpacked image `get_frame` would return.
+    struct EGrabberFrameLease
+    {
+        const void* data;
+        size_t nbytes;
+        struct ImageInfo info;
+        enum EGrabberPixelPacking packing;
+
+        /// Opaque. Owned by the driver.
+        void* handle;
+    };
+
+    /// Blocks until the next frame is available and fills `lease` with a
+    /// view of the grabber's buffer. No copy is made.
+    enum DeviceStatusCode egrabber_camera_lease_frame(
+      struct Camera* camera,
+      struct EGrabberFrameLease* lease);
+
+    /// Returns a leased buffer to the grabber's input queue. `lease` is
+    /// cleared.
+    enum DeviceStatusCode egrabber_camera_release_frame(
+      struct Camera* camera,
+      struct EGrabberFrameLease* lease);
+
+/// EGrabberBufferPolicy::numa_node value for the NUMA node the frame grabber
+/// is attached to.
+#define EGRABBER_NUMA_NODE_GRABBER (-2)
+
+    /// Controls how many buffers are announced to the grabber. The count is
+    /// recomputed from the current payload size whenever the buffers are
+    /// reallocated (on `set` and `start`).
+    struct EGrabberBufferPolicy
+    {
+        /// Upper bound on the total size of the announced buffers.
+        /// 0 means unbounded.
+        uint64_t budget_bytes;
+
+        /// When positive, size the pool to hold this many seconds of frames
+        /// at the camera's current frame rate (still capped by
+        /// `budget_bytes`). Otherwise fill the budget.
+        float seconds;
+
+        /// Bounds on the buffer count. At least 2 buffers are always used.
+        uint32_t min_count, max_count;
+
+        /// Number of images packed into each buffer (GenTL
+        /// `BufferPartCount`). Values above 1 cut per-buffer overhead at
+        /// high frame rates. Images are still returned one at a time.
+        uint32_t images_per_buffer;
+
+        /// When non-zero, the driver allocates the buffers itself and
+        /// announces them to the grabber as user memory, instead of letting
+        /// the GenTL producer allocate them. `page_bytes` and `lock_memory`
+        /// only apply in that case.
+        uint8_t user_memory;
+
+        /// Preferred page size in bytes, e.g. 2 MB or 1 GB huge pages. A
+        /// power of two, or 0 for the system default. Falls back to smaller
+        /// pages when needed, e.g. when the NUMA node is out of huge pages.
+        uint64_t page_bytes;
+
+        /// NUMA node to allocate on, EGRABBER_NUMA_NODE_GRABBER for the
+        /// frame grabber's node, or -1 for no preference. Buffers allocated
+        /// by the GenTL producer only get this as a preference.
+        int32_t numa_node;
+
+        /// When non-zero, lock the buffers in RAM.
+        uint8_t lock_memory;
+    };
+
+    /// Takes effect the next time the buffers are reallocated.
+    enum DeviceStatusCode egrabber_camera_set_buffer_policy(
+      struct Camera* camera,
+      const struct EGrabberBufferPolicy* policy);
+
+    enum DeviceStatusCode egrabber_camera_get_buffer_policy(
+      const struct Camera* camera,
+      struct EGrabberBufferPolicy* policy);
+
+    /// Counters for the current (or most recent) acquisition. Reset on
+    /// `start`.
+    struct EGrabberStats
+    {
+        /// Images popped from the grabber by the acquisition thread.
+        uint64_t frames_acquired;
+
+        /// Images that never reached the driver, detected as gaps in the
+        /// grabber's frame counter. Either the grabber ran out of buffers or
+        /// the link lost them.
+        uint64_t frames_lost;
+
+        /// Buffers dropped by the driver because the consumer fell behind
+        /// and the queue between the acquisition thread and `get_frame` was
+        /// full.
+        uint64_t queue_overflows;
+
+        /// Size of that queue and its highest occupancy so far.
+        uint32_t queue_capacity;
+        uint32_t queue_high_water;
+
+        /// How long the most recent `set` and `start` took, including any
+        /// buffer reallocation.
+        double last_configure_ms;
+        double last_start_ms;
+
+        /// Software triggers executed, and how many of them were matched
+        /// with a frame while triggered acquisition was running.
+        uint64_t software_triggers;
+        uint64_t triggered_frames;
+
+        /// Host time from executing a software trigger to the acquisition
+        /// thread popping its frame, over `triggered_frames`.
+        double trigger_latency_mean_us;
+        double trigger_latency_max_us;
+
+        /// Whether the thread receiving buffers runs at the priority set
+        /// with `egrabber_camera_set_thread_priority`.
+        uint8_t realtime;
+
+        /// Delay from the grabber timestamping a buffer to the driver
+        /// receiving it, above the shortest such delay since `start`. Mostly
+        /// time the receiving thread spent waiting to be scheduled.
+        double receive_jitter_mean_us;
+        double receive_jitter_max_us;
+
+        /// Time the receiving thread spent runnable but waiting for a CPU
+        /// since `start`. Linux only. Summed over the threads receiving
+        /// buffers when there are several data streams.
+        double run_queue_wait_ms;
+
+        /// Data streams the camera's frames are received from. Set
+        /// `ACQUIRE_EGRABBER_DATA_STREAMS` to open fewer.
+        uint32_t data_streams;
+
+        /// How long the most recent `stop` took, and its phases in order:
+        /// unblocking a waiting `get_frame` and pending pops (including
+        /// waiting for another call to finish with the camera), joining the
+        /// acquisition threads, stopping the grabbers, and restoring
+        /// `TriggerMode`.
+        double last_stop_ms;
+        double stop_unblock_ms;
+        double stop_join_ms;
+        double stop_grabber_ms;
+        double stop_settings_ms;
+    };
+
+    enum DeviceStatusCode egrabber_camera_get_stats(
+      const struct Camera* camera,
+      struct EGrabberStats* stats);
+
+    /// `get` and `get_meta` answer from shadow copies of the camera's
+    /// settings and capabilities, kept up to date by `set`. Use this when the
+    /// camera may have been changed by something other than the driver: the
+    /// shadow copies are discarded and the settings read back from the
+    /// device. `properties` may be NULL.
+    enum DeviceStatusCode egrabber_camera_refresh_properties(
+      struct Camera* camera,
+      struct CameraProperties* properties);
+
+    /// Runs the thread receiving buffers (the acquisition thread, or the
+    /// grabber's callback thread) at real-time `priority`: SCHED_FIFO on
+    /// Linux, time critical on Windows. 0, the default, is normal
+    /// scheduling. Takes effect on the next `start`. When the priority can't
+    /// be set, acquisition runs at normal priority; see
+    /// `EGrabberStats::realtime`. Memory isn't locked by this: lock the
+    /// buffers with `EGrabberBufferPolicy::lock_memory`.
+    enum DeviceStatusCode egrabber_camera_set_thread_priority(
+      struct Camera* camera,
+      int32_t priority);
+
+    /// Executes `count` software triggers, `interval_us` apart, as
+    /// `execute_trigger` would. Waits for the whole batch. Stops early if
+    /// acquisition stops. When the camera's trigger source is already
+    /// Software, each trigger is a single command to the camera.
+    enum DeviceStatusCode egrabber_camera_fire_triggers(struct Camera* camera,
+                                                        uint32_t count,
+                                                        uint64_t interval_us);
+
+    /// GenTL module a feature belongs to.
+    enum EGrabberModule
+    {
+        /// The camera itself.
+        EGrabberModule_Remote = 0,
+        EGrabberModule_Device,
+        EGrabberModule_Stream,
+        EGrabberModule_Interface,
+        EGrabberModule_System,
+    };
+
+    enum EGrabberFeatureType
+    {
+        EGrabberFeatureType_Integer = 0,
+        EGrabberFeatureType_Float,
+        /// Also used for enumerations, by entry name.
+        EGrabberFeatureType_String,
+        /// Executed on `set`. Not readable.
+        EGrabberFeatureType_Command,
+    };
+
+#define EGRABBER_INVALID_FEATURE (0xFFFFFFFFU)
+
+    struct EGrabberFeature
+    {
+        const char* name;
+        enum EGrabberModule module;
+        enum EGrabberFeatureType type;
+    };
+
+    /// One feature's value in a bulk get or set. Only the field matching the
+    /// feature's type is used.
+    struct EGrabberFeatureValue
+    {
+        /// From `egrabber_camera_register_features`.
+        uint32_t handle;
+
+        int64_t integer;
+        double number;
+        char string[128];
+
+        /// Outcome for this feature alone.
+        enum DeviceStatusCode status;
+    };
+
+    /// Checks `count` features once, so they can be read and written in
+    /// bulk by handle. A handle stands for the feature's module, name and
+    /// type; each access still addresses the feature by name, since the
+    /// eGrabber API has no node handles. What registering saves is the
+    /// availability check and validation on every access, and bulk calls
+    /// take the camera's lock once per batch. Features the camera doesn't
+    /// have get `EGRABBER_INVALID_FEATURE` and the call fails, but the other
+    /// handles are still filled in. Handles stay valid until the camera is
+    /// closed.
+    enum DeviceStatusCode egrabber_camera_register_features(
+      struct Camera* camera,
+      const struct EGrabberFeature* features,
+      uint32_t count,
+      uint32_t* handles);
+
+    /// Reads `count` features in one call. Each value's `status` tells
+    /// whether that feature was read. The call fails if any of them failed.
+    enum DeviceStatusCode egrabber_camera_get_features(
+      struct Camera* camera,
+      struct EGrabberFeatureValue* values,
+      uint32_t count);
+
+    /// Writes `count` features in order, in one call. Writes that fail don't
+    /// stop the rest. Shadowed settings (ROI, binning, pixel type, exposure,
+    /// trigger) are kept in sync, so `get` sees the new values. Other writes
+    /// that change those settings as a side effect, like `UserSetLoad`, need
+    /// `egrabber_camera_refresh_properties` afterwards.
+    enum DeviceStatusCode egrabber_camera_set_features(
+      struct Camera* camera,
+      struct EGrabberFeatureValue* values,
+      uint32_t count);
+
+    /// How frames from the cameras of a group are matched into sets.
+    enum EGrabberGroupAlignment
+    {
+        /// By frame counter, counted from each camera's first frame after
+        /// `egrabber_group_start`. Every camera must see every trigger, so
+        /// the common trigger has to be held off until the group started.
+        /// A camera that misses the first trigger is off by one in every
+        /// set, which can't be told from the frame counters. Such sets are
+        /// still returned; when their timestamps are further apart than
+        /// `timestamp_tolerance_us`, the driver logs it.
+        EGrabberGroupAlignment_FrameId = 0,
+        /// By hardware timestamp, within `timestamp_tolerance_us`. The
+        /// cameras' grabbers must share a clock, like grabbers in one host.
+        EGrabberGroupAlignment_Timestamp,
+    };
+
+    struct EGrabberGroupConfig
+    {
+        enum EGrabberGroupAlignment alignment;
+
+        /// Largest timestamp difference within a set. 0 for 1000 us.
+        double timestamp_tolerance_us;
+
+        /// When `enable` is set, written to the frame start trigger of every
+        /// camera by `egrabber_group_start`, e.g. Line0 for a common
+        /// hardware trigger. Otherwise each camera keeps its own.
+        struct Trigger frame_start;
+    };
+
+    struct EGrabberGroupStats
+    {
+        /// Frame sets returned since `egrabber_group_start`.
+        uint64_t frame_sets;
+
+        /// Frames released because no other camera had a matching frame,
+        /// e.g. because it lost one.
+        uint64_t unmatched_frames;
+
+        /// Largest spread of the hardware timestamps within a set.
+        double set_skew_max_us;
+
+        /// Time between the first and the last camera finishing `start`.
+        double start_skew_ms;
+    };
+
+    /// Cameras started, stopped and triggered together, whose frames are
+    /// returned in sets, one frame per camera.
+    struct EGrabberGroup;
+
+    /// Groups `count` cameras opened with `driver`. A camera belongs to at
+    /// most one group, and while it does, frames should only be taken
+    /// through the group. Destroy the group before closing its cameras.
+    enum DeviceStatusCode egrabber_driver_create_group(
+      struct Driver* driver,
+      struct Camera* const* cameras,
+      uint32_t count,
+      const struct EGrabberGroupConfig* config,
+      struct EGrabberGroup** group);
+
+    /// Stops the group's cameras and frees `group`.
+    enum DeviceStatusCode egrabber_group_destroy(struct EGrabberGroup* group);
+
+    /// Applies the common trigger, if any, then starts every camera in
+    /// parallel. Fails, with every camera stopped, if any camera fails to
+    /// start. Hardware triggers should only be sent once this returns.
+    enum DeviceStatusCode egrabber_group_start(struct EGrabberGroup* group);
+
+    /// Stops every camera in parallel and releases frames held for
+    /// matching. May be called from any thread, including while another
+    /// thread waits in `egrabber_group_get_frame_set`: that wait returns
+    /// `EGrabberFrame_Stopped` first.
+    enum DeviceStatusCode egrabber_group_stop(struct EGrabberGroup* group);
+
+    /// Executes a software trigger on every camera, in parallel.
+    enum DeviceStatusCode egrabber_group_execute_trigger(
+      struct EGrabberGroup* group);
+
+    /// Waits at most `timeout_ms` for the next set of matching frames and
+    /// leases them into `leases`, one per camera in the order the group was
+    /// created with. Frames without a match on every other camera are
+    /// released. Hand the set back with `egrabber_group_release_frame_set`.
+    ///
+    /// Frame sets are taken by one consumer thread at a time. While it
+    /// waits, other threads may stop or trigger the group; a stop makes the
+    /// wait return `EGrabberFrame_Stopped`. Stop the group, and let the
+    /// wait return, before destroying it.
+    enum EGrabberFrameStatus egrabber_group_get_frame_set(
+      struct EGrabberGroup* group,
+      struct EGrabberFrameLease* leases,
+      uint64_t timeout_ms);
+
+    enum DeviceStatusCode egrabber_group_release_frame_set(
+      struct EGrabberGroup* group,
+      struct EGrabberFrameLease* leases);
+
+    enum DeviceStatusCode egrabber_group_get_stats(
+      const struct EGrabberGroup* group,
+      struct EGrabberGroupStats* stats);
+
+    typedef enum DeviceStatusCode (*egrabber_driver_refresh_discovery_t)(
+      struct Driver*);
+    typedef enum DeviceStatusCode (*egrabber_driver_set_acquisition_mode_t)(
+      struct Driver*,
+      enum EGrabberAcquisitionMode);
+
+    typedef enum DeviceStatusCode (*egrabber_camera_lease_frame_t)(
+      struct Camera*,
+      struct EGrabberFrameLease*);
+    typedef enum DeviceStatusCode (*egrabber_camera_release_frame_t)(
+      struct Camera*,
+      struct EGrabberFrameLease*);
+
+    typedef enum DeviceStatusCode (*egrabber_camera_set_buffer_policy_t)(
+      struct Camera*,
+      const struct EGrabberBufferPolicy*);
+    typedef enum DeviceStatusCode (*egrabber_camera_get_buffer_policy_t)(
+      const struct Camera*,
+      struct EGrabberBufferPolicy*);
+
+    typedef enum DeviceStatusCode (*egrabber_camera_get_stats_t)(
+      const struct Camera*,
+      struct EGrabberStats*);
+
+    typedef enum EGrabberFrameStatus (*egrabber_camera_try_get_frame_t)(
+      struct Camera*,
+      void*,
+      size_t*,
+      struct ImageInfo*,
+      uint64_t);
+
+    typedef enum DeviceStatusCode (*egrabber_camera_refresh_properties_t)(
+      struct Camera*,
+      struct CameraProperties*);
+
+    typedef enum DeviceStatusCode (
+      *egrabber_camera_fire_triggers_t)(struct Camera*, uint32_t, uint64_t);
+
+    typedef enum DeviceStatusCode (
+      *egrabber_camera_set_thread_priority_t)(struct Camera*, int32_t);
+
+    typedef enum DeviceStatusCode (*egrabber_camera_register_features_t)(
+      struct Camera*,
+      const struct EGrabberFeature*,
+      uint32_t,
+      uint32_t*);
+    typedef enum DeviceStatusCode (*egrabber_camera_get_features_t)(
+      struct Camera*,
+      struct EGrabberFeatureValue*,
+      uint32_t);
+    typedef enum DeviceStatusCode (*egrabber_camera_set_features_t)(
+      struct Camera*,
+      struct EGrabberFeatureValue*,
+      uint32_t);
+
+    typedef enum DeviceStatusCode (*egrabber_driver_create_group_t)(
+      struct Driver*,
+      struct Camera* const*,
+      uint32_t,
+      const struct EGrabberGroupConfig*,
+      struct EGrabberGroup**);
+    typedef enum DeviceStatusCode (*egrabber_group_destroy_t)(
+      struct EGrabberGroup*);
+    typedef enum DeviceStatusCode (*egrabber_group_start_t)(
+      struct EGrabberGroup*);
+    typedef enum DeviceStatusCode (*egrabber_group_stop_t)(
+      struct EGrabberGroup*);
+    typedef enum DeviceStatusCode (*egrabber_group_execute_trigger_t)(
+      struct EGrabberGroup*);
+    typedef enum EGrabberFrameStatus (*egrabber_group_get_frame_set_t)(
+      struct EGrabberGroup*,
+      struct EGrabberFrameLease*,
+      uint64_t);
+    typedef enum DeviceStatusCode (*egrabber_group_release_frame_set_t)(
+      struct EGrabberGroup*,
+      struct EGrabberFrameLease*);
+    typedef enum DeviceStatusCode (*egrabber_group_get_stats_t)(
+      const struct EGrabberGroup*,
+      struct EGrabberGroupStats*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_V0
@@ -0,0 +1,160 @@
+/// @file Shadow copies of camera feature values.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_FEATURE_CACHE_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_FEATURE_CACHE_V0
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// The value of an integer, float or string (enumeration) feature.
+typedef std::variant<int64_t, double, std::string> FeatureValue;
+
+struct FeatureWrite
+{
+    std::string name;
+    FeatureValue value;
+};
+
+/// Remembers the values of GenICam features so repeated reads don't make a
+/// round trip over the control link.
+///
+/// Only features the driver itself controls should go through the cache:
+/// values changed behind its back (by the camera, or another application)
+/// are only seen after `invalidate_all()`.
+///
+/// Writes go straight to the device. Integer and string (enumeration)
+/// writes are exact, so the written value is kept. Float writes may be
+/// rounded by the device, so the next read fetches the actual value.
+/// Writing a feature also forgets every feature registered as depending on
+/// it with `add_dependency()`.
+///
+/// `Module` is the eGrabber module the features belong to, e.g.
+/// `Euresys::RemoteModule`. Not thread-safe.
+template<typename Module, typename Grabber>
+struct FeatureCache final
+{
+    explicit FeatureCache(Grabber& grabber)
+      : grabber_(grabber)
+      , reads_(0)
+      , hits_(0)
+    {
+    }
+
+    /// Writing `feature` may change the value of each of `dependents`.
+    void add_dependency(const std::string& feature,
+                        std::initializer_list<const char*> dependents)
+    {
+        auto& v = dependents_[feature];
+        for (const auto* d : dependents)
+            v.emplace_back(d);
+    }
+
+    int64_t get_integer(const std::string& name)
+    {
+        return get_<int64_t>(name, [&] {
+            return grabber_.template getInteger<Module>(name);
+        });
+    }
+
+    double get_float(const std::string& name)
+    {
+        return get_<double>(
+          name, [&] { return grabber_.template getFloat<Module>(name); });
+    }
+
+    std::string get_string(const std::string& name)
+    {
+        return get_<std::string>(
+          name, [&] { return grabber_.template getString<Module>(name); });
+    }
+
+    void set_integer(const std::string& name, int64_t value)
+    {
+        grabber_.template setInteger<Module>(name, value);
+        wrote_(name);
+        values_[name] = value;
+    }
+
+    void set_float(const std::string& name, double value)
+    {
+        grabber_.template setFloat<Module>(name, value);
+        wrote_(name);
+    }
+
+    void set_string(const std::string& name, const std::string& value)
+    {
+        grabber_.template setString<Module>(name, value);
+        wrote_(name);
+        values_[name] = value;
+    }
+
+    void set(const FeatureWrite& w)
+    {
+        if (const auto* i = std::get_if<int64_t>(&w.value))
+            set_integer(w.name, *i);
+        else if (const auto* f = std::get_if<double>(&w.value))
+            set_float(w.name, *f);
+        else
+            set_string(w.name, std::get<std::string>(w.value));
+    }
+
+    /// Writes each feature in order.
+    void apply(const std::vector<FeatureWrite>& writes)
+    {
+        for (const auto& w : writes)
+            set(w);
+    }
+
+    /// Forgets `name`. The next read goes to the device.
+    void invalidate(const std::string& name) { values_.erase(name); }
+
+    /// Forgets everything. Use when the device may have changed on its own.
+    void invalidate_all() { values_.clear(); }
+
+    /// Reads that went to the device.
+    uint64_t reads() const { return reads_; }
+
+    /// Reads answered from the cache.
+    uint64_t hits() const { return hits_; }
+
+  private:
+    Grabber& grabber_;
+    std::unordered_map<std::string, FeatureValue> values_;
+    std::unordered_map<std::string, std::vector<std::string>> dependents_;
+    uint64_t reads_;
+    uint64_t hits_;
+
+    template<typename T, typename Read>
+    T get_(const std::string& name, Read&& read)
+    {
+        // A value cached as another type (e.g. an enumeration written as a
+        // string and read as an integer) counts as a miss.
+        const auto it = values_.find(name);
+        if (it != values_.end()) {
+            if (const auto* v = std::get_if<T>(&it->second)) {
+                ++hits_;
+                return *v;
+            }
+        }
+        T v = read();
+        ++reads_;
+        values_[name] = v;
+        return v;
+    }
+
+    void wrote_(const std::string& name)
+    {
+        values_.erase(name);
+        const auto it = dependents_.find(name);
+        if (it == dependents_.end())
+            return;
+        for (const auto& d : it->second)
+            values_.erase(d);
+    }
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_FEATURE_CACHE_V0
@@ -0,0 +1,69 @@
+/// @file Registry of arbitrary GenICam features read and written in bulk.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_FEATURE_REGISTRY_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_FEATURE_REGISTRY_V0
+
+#include "euresys.egrabber.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Features checked once and referred to by a small integer afterwards.
+///
+/// A handle is an index into a table of names, so turning one back into a
+/// feature is a bounds check. It is not a GenApi node: the eGrabber API only
+/// addresses features by name, and every read or write still looks the
+/// feature up that way. Registering only saves the availability check and
+/// the argument validation on every access. Registering the same feature
+/// twice returns the same handle. Handles stay valid for the life of the
+/// camera. Not thread-safe.
+struct FeatureRegistry final
+{
+    struct Entry
+    {
+        std::string name;
+        enum EGrabberModule module;
+        enum EGrabberFeatureType type;
+
+        /// Whether the driver keeps a shadow copy of this feature. Reads
+        /// and writes of those must go through the FeatureCache.
+        bool shadowed;
+    };
+
+    std::optional<uint32_t> find(enum EGrabberModule module,
+                                 const std::string& name) const
+    {
+        const auto it = index_.find(key_(module, name));
+        if (it == index_.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    uint32_t add(Entry entry)
+    {
+        const auto handle = (uint32_t)entries_.size();
+        index_[key_(entry.module, entry.name)] = handle;
+        entries_.push_back(std::move(entry));
+        return handle;
+    }
+
+    /// nullptr for a handle that was never returned by add().
+    const Entry* get(uint32_t handle) const
+    {
+        return handle < entries_.size() ? &entries_[handle] : nullptr;
+    }
+
+  private:
+    std::vector<Entry> entries_;
+    std::unordered_map<std::string, uint32_t> index_;
+
+    static std::string key_(enum EGrabberModule module,
+                            const std::string& name)
+    {
+        return std::to_string((int)module) + ":" + name;
+    }
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_FEATURE_REGISTRY_V0
@@ -0,0 +1,97 @@
+/// @file Per-acquisition description of the images in the grabber's buffers.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_FRAME_LAYOUT_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_FRAME_LAYOUT_V0
+
+#include "pixel.unpack.hh"
+#include "device/props/components.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/// Shape, pixel type and placement of the images in a buffer. These are fixed
+/// between `start()` and `stop()`, so they are resolved once when acquisition
+/// starts. Describing a frame then only fills in the per-frame fields.
+struct FrameLayout final
+{
+    /// Precomputed image info. Only the timestamp and frame id change from
+    /// frame to frame.
+    struct ImageInfo info;
+
+    /// Bytes in one image once unpacked.
+    size_t image_bytes;
+
+    /// How pixels are stored in the grabber's buffers.
+    PixelPacking packing;
+
+    /// Bytes one image occupies in the grabber's buffers. Smaller than
+    /// `image_bytes` for packed formats.
+    size_t wire_bytes;
+
+    /// Offset between consecutive images in a multi-image buffer.
+    size_t part_stride_bytes;
+
+    /// Images packed in each buffer.
+    uint32_t images_per_buffer;
+
+    FrameLayout()
+      : info{}
+      , image_bytes(0)
+      , packing(PixelPacking::None)
+      , wire_bytes(0)
+      , part_stride_bytes(0)
+      , images_per_buffer(1)
+    {
+    }
+
+    FrameLayout(uint32_t width,
+                uint32_t height,
+                enum SampleType type,
+                size_t bytes_per_pixel,
+                PixelPacking packing,
+                uint32_t images_per_buffer)
+      : info{}
+      , image_bytes((size_t)width * height * bytes_per_pixel)
+      , packing(packing)
+      , wire_bytes(packing == PixelPacking::None
+                     ? image_bytes
+                     : packed_bytes(packing, (size_t)width * height))
+      , part_stride_bytes(wire_bytes)
+      , images_per_buffer(images_per_buffer ? images_per_buffer : 1)
+    {
+        info.shape = {
+            .dims = { .channels = 1,
+                      .width = width,
+                      .height = height,
+                      .planes = 1 },
+            .strides = { .channels = 1,
+                         .width = 1,
+                         .height = (int64_t)width,
+                         .planes = (int64_t)width * height },
+            .type = type,
+        };
+    }
+
+    uint64_t pixel_count() const
+    {
+        return (uint64_t)info.shape.dims.width * info.shape.dims.height;
+    }
+
+    /// Describes image `index` in a buffer starting at `base`. `nbytes` is
+    /// set to the image's size in the buffer, `wire_bytes`.
+    void describe(const void* base,
+                  uint32_t index,
+                  uint64_t timestamp_ns,
+                  uint64_t frame_id,
+                  const void** data,
+                  size_t* nbytes,
+                  struct ImageInfo* out) const
+    {
+        *data = (const uint8_t*)base + index * part_stride_bytes;
+        *nbytes = wire_bytes;
+        *out = info;
+        out->hardware_timestamp = timestamp_ns;
+        out->hardware_frame_id = frame_id;
+    }
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_FRAME_LAYOUT_V0
@@ -0,0 +1,335 @@
+#include "host.memory.hh"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_F_NODE
+#define MPOL_F_NODE (1 << 0)
+#endif
+#ifndef MPOL_F_ADDR
+#define MPOL_F_ADDR (1 << 1)
+#endif
+#endif
+
+namespace {
+
+size_t
+round_up(size_t v, size_t multiple)
+{
+    return ((v + multiple - 1) / multiple) * multiple;
+}
+
+size_t
+system_page_bytes()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/// Size of the huge pages backing an allocation that asked for `page_bytes`,
+/// or 0 if huge pages aren't supported.
+size_t
+huge_page_bytes(size_t page_bytes)
+{
+#if defined(_WIN32)
+    // Windows has a single large page size.
+    (void)page_bytes;
+    return GetLargePageMinimum();
+#elif defined(__linux__)
+    return page_bytes;
+#else
+    (void)page_bytes;
+    return 0;
+#endif
+}
+
+bool
+is_power_of_two(size_t v)
+{
+    return v && !(v & (v - 1));
+}
+
+#ifdef __linux__
+int
+log2_of(size_t v)
+{
+    int n = 0;
+    while (v >>= 1)
+        ++n;
+    return n;
+}
+
+/// Free huge pages of `page_bytes` on `numa_node`, or -1 if unknown.
+long long
+free_huge_pages(int numa_node, size_t page_bytes)
+{
+    std::ifstream f("/sys/devices/system/node/node" +
+                    std::to_string(numa_node) + "/hugepages/hugepages-" +
+                    std::to_string(page_bytes >> 10) + "kB/free_hugepages");
+    long long n = -1;
+    if (!(f >> n))
+        return -1;
+    return n;
+}
+
+/// NUMA node backing the faulted-in page at `p`, or -1 if unknown.
+int
+node_of_page(const uint8_t* p)
+{
+    int node = -1;
+    if (0 != syscall(SYS_get_mempolicy,
+                     &node,
+                     nullptr,
+                     0UL,
+                     p,
+                     (unsigned long)(MPOL_F_NODE | MPOL_F_ADDR)))
+        return -1;
+    return node;
+}
+#endif
+
+/// Whether the node has room for `nbytes` of huge pages. Huge pages are
+/// reserved from the system-wide pool when they're mapped, not per node: a
+/// mapping bound to a node that runs out faults with SIGBUS instead of
+/// failing.
+bool
+node_has_huge_pages(int numa_node, size_t nbytes, size_t page_bytes)
+{
+#ifdef __linux__
+    if (numa_node < 0)
+        return true;
+    const long long free = free_huge_pages(numa_node, page_bytes);
+    return free < 0 || (size_t)free >= nbytes / page_bytes;
+#else
+    (void)numa_node;
+    (void)nbytes;
+    (void)page_bytes;
+    return true;
+#endif
+}
+
+/// Returns nullptr on failure.
+uint8_t*
+map_pages(size_t nbytes, size_t page_bytes, int numa_node)
+{
+#ifdef _WIN32
+    DWORD flags = MEM_RESERVE | MEM_COMMIT;
+    if (page_bytes > system_page_bytes())
+        flags |= MEM_LARGE_PAGES;
+    const DWORD node =
+      numa_node >= 0 ? (DWORD)numa_node : NUMA_NO_PREFERRED_NODE;
+    return (uint8_t*)VirtualAllocExNuma(
+      GetCurrentProcess(), nullptr, nbytes, flags, PAGE_READWRITE, node);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef __linux__
+    if (page_bytes > system_page_bytes())
+        flags |= MAP_HUGETLB | (log2_of(page_bytes) << MAP_HUGE_SHIFT);
+#endif
+    (void)numa_node; // placed by bind_to_node()
+    void* p = mmap(nullptr, nbytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return p == MAP_FAILED ? nullptr : (uint8_t*)p;
+#endif
+}
+
+void
+unmap_pages(uint8_t* data, size_t nbytes)
+{
+#ifdef _WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, nbytes);
+#endif
+}
+
+/// Places not-yet-faulted pages on a NUMA node. Huge pages are only
+/// preferred there, so that a node short of them falls back to another one
+/// rather than faulting. Returns false if that isn't possible. (On Windows,
+/// placement happens in map_pages().)
+bool
+bind_to_node(uint8_t* data, size_t nbytes, int numa_node, bool huge)
+{
+#if defined(__linux__)
+    unsigned long mask[16] = { 0 };
+    const size_t bits = 8 * sizeof(mask[0]);
+    if (numa_node < 0 || (size_t)numa_node >= bits * 16)
+        return false;
+    mask[numa_node / bits] = 1UL << (numa_node % bits);
+    return 0 == syscall(SYS_mbind,
+                        data,
+                        nbytes,
+                        huge ? MPOL_PREFERRED : MPOL_BIND,
+                        mask,
+                        (unsigned long)(bits * 16),
+                        0);
+#elif defined(_WIN32)
+    (void)huge;
+    return numa_node >= 0;
+#else
+    (void)huge;
+    return false;
+#endif
+}
+
+bool
+lock_pages(uint8_t* data, size_t nbytes)
+{
+#ifdef _WIN32
+    return VirtualLock(data, nbytes) != 0;
+#else
+    return mlock(data, nbytes) == 0;
+#endif
+}
+
+} // end anonymous namespace
+
+HostMemory::HostMemory()
+  : data_(nullptr)
+  , nbytes_(0)
+  , mapped_bytes_(0)
+  , page_bytes_(0)
+  , is_locked_(false)
+  , numa_node_(-1)
+{
+}
+
+HostMemory::~HostMemory()
+{
+    release();
+}
+
+HostMemory::HostMemory(HostMemory&& other) noexcept
+  : HostMemory()
+{
+    *this = std::move(other);
+}
+
+HostMemory&
+HostMemory::operator=(HostMemory&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        std::swap(data_, other.data_);
+        std::swap(nbytes_, other.nbytes_);
+        std::swap(mapped_bytes_, other.mapped_bytes_);
+        std::swap(page_bytes_, other.page_bytes_);
+        std::swap(is_locked_, other.is_locked_);
+        std::swap(numa_node_, other.numa_node_);
+    }
+    return *this;
+}
+
+HostMemory
+HostMemory::allocate(size_t nbytes, const Options& options)
+{
+    HostMemory out;
+    if (!nbytes)
+        return out;
+    if (options.page_bytes && !is_power_of_two(options.page_bytes))
+        throw std::invalid_argument("Page size must be a power of two");
+
+    // Try the preferred page size, then 2 MB pages, then default pages.
+    const size_t base_page = system_page_bytes();
+    const size_t candidates[] = { options.page_bytes, 2ULL << 20, base_page };
+    for (auto page : candidates) {
+        if (page <= base_page || page > options.page_bytes)
+            page = base_page;
+        else if (!(page = huge_page_bytes(page)))
+            continue;
+        const size_t mapped = round_up(nbytes, page);
+        // Rather smaller pages on the node than huge pages elsewhere.
+        if (page > base_page &&
+            !node_has_huge_pages(options.numa_node, mapped, page))
+            continue;
+        if (auto* p = map_pages(mapped, page, options.numa_node)) {
+            out.data_ = p;
+            out.nbytes_ = nbytes;
+            out.mapped_bytes_ = mapped;
+            out.page_bytes_ = page;
+            break;
+        }
+    }
+    if (!out.data_)
+        throw std::runtime_error("Failed to allocate host memory");
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Fell back to default pages. Transparent huge pages may still help.
+    if (out.page_bytes_ == base_page && options.page_bytes > base_page)
+        madvise(out.data_, out.mapped_bytes_, MADV_HUGEPAGE);
+#endif
+
+    const bool huge = out.page_bytes_ > base_page;
+    const bool placed =
+      options.numa_node >= 0 &&
+      bind_to_node(out.data_, out.mapped_bytes_, options.numa_node, huge);
+
+    // Prefault every page.
+    for (size_t i = 0; i < out.mapped_bytes_; i += out.page_bytes_)
+        ((volatile uint8_t*)out.data_)[i] = 0;
+
+    if (placed) {
+        out.numa_node_ = options.numa_node;
+#ifdef __linux__
+        // Only preferred: check where the first and last pages landed.
+        if (huge &&
+            (node_of_page(out.data_) != options.numa_node ||
+             node_of_page(out.data_ + out.mapped_bytes_ - out.page_bytes_) !=
+               options.numa_node))
+            out.numa_node_ = -1;
+#endif
+    }
+
+    if (options.lock) {
+#ifdef _WIN32
+        // Large pages are never paged out.
+        out.is_locked_ = out.page_bytes_ > base_page ||
+                         lock_pages(out.data_, out.mapped_bytes_);
+#else
+        out.is_locked_ = lock_pages(out.data_, out.mapped_bytes_);
+#endif
+    }
+
+    return out;
+}
+
+void
+HostMemory::release()
+{
+    if (!data_)
+        return;
+#ifndef _WIN32
+    if (is_locked_)
+        munlock(data_, mapped_bytes_);
+#endif
+    unmap_pages(data_, mapped_bytes_);
+    data_ = nullptr;
+    nbytes_ = mapped_bytes_ = page_bytes_ = 0;
+    is_locked_ = false;
+    numa_node_ = -1;
+}
@@ -0,0 +1,62 @@
+/// @file Host memory for buffers the driver announces to the grabber itself.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_HOST_MEMORY_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_HOST_MEMORY_V0
+
+#include <cstddef>
+#include <cstdint>
+
+/// A single large allocation, optionally backed by huge pages, bound to a
+/// NUMA node and locked in RAM. Pages are faulted in up front so the first
+/// frames written by DMA don't pay for it.
+///
+/// Move-only. The memory is released when the owner is destroyed.
+struct HostMemory final
+{
+    struct Options
+    {
+        /// Preferred page size in bytes, e.g. 2 MB or 1 GB. Must be a power
+        /// of two. 0 uses the system's default page size. Falls back to
+        /// smaller pages when the preferred size can't be used, including
+        /// when `numa_node` doesn't have enough free huge pages.
+        size_t page_bytes;
+
+        /// NUMA node to place the memory on. -1 for no preference.
+        int numa_node;
+
+        /// Lock the pages in RAM (mlock/VirtualLock).
+        bool lock;
+    };
+
+    HostMemory();
+    ~HostMemory();
+    HostMemory(HostMemory&& other) noexcept;
+    HostMemory& operator=(HostMemory&& other) noexcept;
+    HostMemory(const HostMemory&) = delete;
+    HostMemory& operator=(const HostMemory&) = delete;
+
+    /// Throws std::runtime_error if no memory could be allocated at all, and
+    /// std::invalid_argument for a page size that isn't a power of two.
+    /// Failing to honour a preference (page size, node, lock) is not an
+    /// error; the accessors report what was actually done.
+    static HostMemory allocate(size_t nbytes, const Options& options);
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return nbytes_; }
+
+    /// Page size actually backing the allocation.
+    size_t page_bytes() const { return page_bytes_; }
+    bool is_locked() const { return is_locked_; }
+    int numa_node() const { return numa_node_; }
+
+    void release();
+
+  private:
+    uint8_t* data_;
+    size_t nbytes_;
+    size_t mapped_bytes_;
+    size_t page_bytes_;
+    bool is_locked_;
+    int numa_node_;
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_HOST_MEMORY_V0
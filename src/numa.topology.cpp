@@ -0,0 +1,232 @@
+#include "numa.topology.hh"
+
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#endif
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#endif
+
+namespace {
+
+#ifdef __linux__
+// PCI vendor id of Euresys.
+constexpr const char* EURESYS_PCI_VENDOR = "0x1805";
+
+constexpr size_t MASK_BITS = 8 * sizeof(unsigned long);
+constexpr size_t MASK_WORDS = 16;
+
+std::string
+read_line(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+/// Parses a sysfs CPU list, e.g. "0-7,16-23".
+std::vector<int>
+parse_cpu_list(const std::string& list)
+{
+    std::vector<int> out;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty())
+            continue;
+        const auto dash = range.find('-');
+        const int lo = std::atoi(range.c_str());
+        const int hi =
+          dash == std::string::npos ? lo : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = lo; cpu <= hi; ++cpu)
+            out.push_back(cpu);
+    }
+    return out;
+}
+
+bool
+to_cpu_set(const std::vector<int>& cpus, cpu_set_t* set)
+{
+    CPU_ZERO(set);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, set);
+    return CPU_COUNT(set) > 0;
+}
+#endif
+
+#ifdef _WIN32
+// CPUs are numbered 64 per processor group.
+bool
+to_group_affinity(const std::vector<int>& cpus, GROUP_AFFINITY* out)
+{
+    *out = {};
+    if (cpus.empty())
+        return false;
+    out->Group = (WORD)(cpus.front() / 64);
+    for (int cpu : cpus)
+        if (cpu / 64 == out->Group)
+            out->Mask |= (KAFFINITY)1 << (cpu % 64);
+    return out->Mask != 0;
+}
+#endif
+
+} // end anonymous namespace
+
+int
+numa_node_count()
+{
+#if defined(__linux__)
+    int n = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(
+           "/sys/devices/system/node", ec)) {
+        const auto name = entry.path().filename().string();
+        if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+            std::isdigit((unsigned char)name[4]))
+            ++n;
+    }
+    return n ? n : 1;
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? (int)highest + 1 : 1;
+#else
+    return 1;
+#endif
+}
+
+std::vector<int>
+grabber_numa_nodes()
+{
+    std::vector<int> out;
+#ifdef __linux__
+    std::error_code ec;
+    for (const auto& entry :
+         std::filesystem::directory_iterator("/sys/bus/pci/devices", ec)) {
+        if (read_line(entry.path() / "vendor") != EURESYS_PCI_VENDOR)
+            continue;
+        const auto node = read_line(entry.path() / "numa_node");
+        out.push_back(node.empty() ? -1 : std::atoi(node.c_str()));
+    }
+#endif
+    return out;
+}
+
+std::vector<int>
+numa_node_cpus(int node)
+{
+    if (node < 0)
+        return {};
+#if defined(__linux__)
+    return parse_cpu_list(read_line("/sys/devices/system/node/node" +
+                                    std::to_string(node) + "/cpulist"));
+#elif defined(_WIN32)
+    GROUP_AFFINITY affinity = {};
+    if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity))
+        return {};
+    std::vector<int> out;
+    for (int bit = 0; bit < 64; ++bit)
+        if (affinity.Mask & ((KAFFINITY)1 << bit))
+            out.push_back(affinity.Group * 64 + bit);
+    return out;
+#else
+    return {};
+#endif
+}
+
+bool
+pin_thread(std::thread& thread, const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    return to_cpu_set(cpus, &set) &&
+           0 == pthread_setaffinity_np(
+                  thread.native_handle(), sizeof(set), &set);
+#elif defined(_WIN32)
+    GROUP_AFFINITY affinity;
+    return to_group_affinity(cpus, &affinity) &&
+           SetThreadGroupAffinity(
+             (HANDLE)thread.native_handle(), &affinity, nullptr);
+#else
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
+}
+
+bool
+pin_current_thread(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    return to_cpu_set(cpus, &set) &&
+           0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    GROUP_AFFINITY affinity;
+    return to_group_affinity(cpus, &affinity) &&
+           SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+ScopedPreferredNode::ScopedPreferredNode(int node)
+  : active_(false)
+  , saved_mode_(0)
+  , saved_mask_{}
+{
+#ifdef __linux__
+    if (node < 0 || (size_t)node >= MASK_BITS * MASK_WORDS)
+        return;
+    if (0 != syscall(SYS_get_mempolicy,
+                     &saved_mode_,
+                     saved_mask_,
+                     (unsigned long)(MASK_BITS * MASK_WORDS),
+                     nullptr,
+                     0UL))
+        return;
+    unsigned long mask[MASK_WORDS] = { 0 };
+    mask[node / MASK_BITS] = 1UL << (node % MASK_BITS);
+    active_ = 0 == syscall(SYS_set_mempolicy,
+                           MPOL_PREFERRED,
+                           mask,
+                           (unsigned long)(MASK_BITS * MASK_WORDS));
+#else
+    (void)node;
+#endif
+}
+
+ScopedPreferredNode::~ScopedPreferredNode()
+{
+#ifdef __linux__
+    if (!active_)
+        return;
+    // The default policy takes no nodes.
+    syscall(SYS_set_mempolicy,
+            saved_mode_,
+            saved_mode_ == MPOL_DEFAULT ? nullptr : saved_mask_,
+            saved_mode_ == MPOL_DEFAULT
+              ? 0UL
+              : (unsigned long)(MASK_BITS * MASK_WORDS));
+#endif
+}
@@ -0,0 +1,52 @@
+/// @file Where the frame grabber sits in the host's NUMA topology.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_NUMA_TOPOLOGY_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_NUMA_TOPOLOGY_V0
+
+#include <thread>
+#include <vector>
+
+/// Number of NUMA nodes on the host. 1 when unknown.
+int
+numa_node_count();
+
+/// NUMA node of each Euresys frame grabber on the PCIe bus, -1 where the
+/// platform doesn't say. Empty when none was found or they can't be listed.
+/// Only implemented on Linux, through sysfs.
+std::vector<int>
+grabber_numa_nodes();
+
+/// CPUs of `node`. Empty when unknown.
+std::vector<int>
+numa_node_cpus(int node);
+
+/// Restricts `thread` to run on `cpus`. Returns false if that isn't
+/// possible.
+bool
+pin_thread(std::thread& thread, const std::vector<int>& cpus);
+
+/// Same for the calling thread.
+bool
+pin_current_thread(const std::vector<int>& cpus);
+
+/// While in scope, memory first touched by the calling thread is preferably
+/// placed on `node`. Used around allocations made on our behalf, like the
+/// GenTL producer's buffers. Does nothing for a negative node or where the
+/// platform doesn't support it.
+struct ScopedPreferredNode final
+{
+    explicit ScopedPreferredNode(int node);
+    ~ScopedPreferredNode();
+
+    ScopedPreferredNode(const ScopedPreferredNode&) = delete;
+    ScopedPreferredNode& operator=(const ScopedPreferredNode&) = delete;
+
+    /// Whether the preference was set.
+    bool is_active() const { return active_; }
+
+  private:
+    bool active_;
+    int saved_mode_;
+    unsigned long saved_mask_[16];
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_NUMA_TOPOLOGY_V0
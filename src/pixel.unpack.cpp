@@ -0,0 +1,208 @@
+#include "pixel.unpack.hh"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/// Bits per packed pixel.
+size_t
+bits_of(PixelPacking packing)
+{
+    switch (packing) {
+        case PixelPacking::Mono10p:
+            return 10;
+        case PixelPacking::Mono12p:
+            return 12;
+        default:
+            return 16;
+    }
+}
+
+/// Unpacks pixels one at a time. Used for the ends of a run that the
+/// group-wise loops can't cover. `first` is the index of the first pixel to
+/// unpack, relative to `src`.
+void
+unpack_bitwise(size_t bits,
+               uint16_t* dst,
+               const uint8_t* src,
+               size_t first,
+               size_t npixels)
+{
+    const uint32_t mask = (1u << bits) - 1;
+    for (size_t i = first; i < first + npixels; ++i) {
+        const size_t bit = i * bits;
+        const size_t byte = bit / 8;
+        // A pixel of up to 12 bits spans at most 3 bytes. Only read the
+        // bytes it covers.
+        const size_t last = (bit + bits - 1) / 8;
+        uint32_t v = 0;
+        for (size_t b = last + 1; b-- > byte;)
+            v = (v << 8) | src[b];
+        dst[i - first] = (uint16_t)((v >> (bit % 8)) & mask);
+    }
+}
+
+void
+unpack_mono10p_groups(uint16_t* dst, const uint8_t* src, size_t ngroups)
+{
+    for (size_t g = 0; g < ngroups; ++g, src += 5, dst += 4) {
+        const uint64_t v = (uint64_t)src[0] | ((uint64_t)src[1] << 8) |
+                           ((uint64_t)src[2] << 16) |
+                           ((uint64_t)src[3] << 24) | ((uint64_t)src[4] << 32);
+        dst[0] = (uint16_t)(v & 0x3ff);
+        dst[1] = (uint16_t)((v >> 10) & 0x3ff);
+        dst[2] = (uint16_t)((v >> 20) & 0x3ff);
+        dst[3] = (uint16_t)((v >> 30) & 0x3ff);
+    }
+}
+
+void
+unpack_mono12p_groups(uint16_t* dst, const uint8_t* src, size_t ngroups)
+{
+    for (size_t g = 0; g < ngroups; ++g, src += 3, dst += 2) {
+        dst[0] = (uint16_t)(src[0] | ((src[1] & 0x0f) << 8));
+        dst[1] = (uint16_t)((src[1] >> 4) | (src[2] << 4));
+    }
+}
+
+#if defined(__AVX2__)
+/// Loads 16 bytes from `a` into the low lane and 16 bytes from `b` into the
+/// high lane.
+__m256i
+load_lanes(const uint8_t* a, const uint8_t* b)
+{
+    return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)a)),
+      _mm_loadu_si128((const __m128i*)b),
+      1);
+}
+
+/// 16 pixels per iteration: two lanes of 8 pixels from 10 bytes each.
+/// Returns the number of pixels unpacked.
+size_t
+unpack_mono10p_avx2(uint16_t* dst, const uint8_t* src, size_t npixels)
+{
+    // Each lane reads 16 bytes but only consumes 10. Stop while the
+    // over-read is still inside the source.
+    const size_t nbytes = packed_bytes(PixelPacking::Mono10p, npixels);
+    // Pixel j of a lane starts at bit 10j: byte (10j)/8, shift (10j)%8.
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, //
+                                             5, 6, 6, 7, 7, 8, 8, 9, //
+                                             0, 1, 1, 2, 2, 3, 3, 4, //
+                                             5, 6, 6, 7, 7, 8, 8, 9);
+    // No variable 16-bit shifts in AVX2. Shift left by (6 - shift) with a
+    // multiply so every pixel sits in bits 6..15, then shift right by 6.
+    const __m256i scale =
+      _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1);
+    size_t i = 0;
+    for (; i + 16 <= npixels && (i / 4) * 5 + 26 <= nbytes; i += 16) {
+        const uint8_t* s = src + (i / 4) * 5;
+        __m256i v = _mm256_shuffle_epi8(load_lanes(s, s + 10), shuffle);
+        v = _mm256_srli_epi16(_mm256_mullo_epi16(v, scale), 6);
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    return i;
+}
+
+/// 16 pixels per iteration: two lanes of 8 pixels from 12 bytes each.
+/// Returns the number of pixels unpacked.
+size_t
+unpack_mono12p_avx2(uint16_t* dst, const uint8_t* src, size_t npixels)
+{
+    // Each lane reads 16 bytes but only consumes 12.
+    const size_t nbytes = packed_bytes(PixelPacking::Mono12p, npixels);
+    // Pixel pair k of a lane is in bytes 3k..3k+2. Even pixels are the low
+    // 12 bits of bytes (3k, 3k+1), odd pixels the high 12 bits of
+    // (3k+1, 3k+2).
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, //
+                                             6, 7, 7, 8, 9, 10, 10, 11,
+                                             0, 1, 1, 2, 3, 4, 4, 5, //
+                                             6, 7, 7, 8, 9, 10, 10, 11);
+    const __m256i low12 = _mm256_set1_epi16(0x0fff);
+    size_t i = 0;
+    for (; i + 16 <= npixels && (i / 2) * 3 + 28 <= nbytes; i += 16) {
+        const uint8_t* s = src + (i / 2) * 3;
+        const __m256i v = _mm256_shuffle_epi8(load_lanes(s, s + 12), shuffle);
+        const __m256i even = _mm256_and_si256(v, low12);
+        const __m256i odd = _mm256_srli_epi16(v, 4);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                            _mm256_blend_epi16(even, odd, 0xaa));
+    }
+    return i;
+}
+#endif
+
+} // end anonymous namespace
+
+PixelGroup
+pixel_group(PixelPacking packing)
+{
+    switch (packing) {
+        case PixelPacking::Mono10p:
+            return { 4, 5 };
+        case PixelPacking::Mono12p:
+            return { 2, 3 };
+        default:
+            return { 1, 2 };
+    }
+}
+
+size_t
+packed_bytes(PixelPacking packing, size_t npixels)
+{
+    return (npixels * bits_of(packing) + 7) / 8;
+}
+
+void
+unpack_pixels_scalar(PixelPacking packing,
+                     uint16_t* dst,
+                     const uint8_t* src,
+                     size_t npixels)
+{
+    const auto group = pixel_group(packing);
+    const size_t ngroups = npixels / group.pixels;
+    switch (packing) {
+        case PixelPacking::Mono10p:
+            unpack_mono10p_groups(dst, src, ngroups);
+            break;
+        case PixelPacking::Mono12p:
+            unpack_mono12p_groups(dst, src, ngroups);
+            break;
+        default:
+            std::memcpy(dst, src, 2 * npixels);
+            return;
+    }
+    const size_t done = ngroups * group.pixels;
+    unpack_bitwise(
+      bits_of(packing), dst + done, src, done, npixels - done);
+}
+
+void
+unpack_pixels(PixelPacking packing,
+              uint16_t* dst,
+              const uint8_t* src,
+              size_t npixels)
+{
+#if defined(__AVX2__)
+    size_t done = 0;
+    switch (packing) {
+        case PixelPacking::Mono10p:
+            done = unpack_mono10p_avx2(dst, src, npixels);
+            break;
+        case PixelPacking::Mono12p:
+            done = unpack_mono12p_avx2(dst, src, npixels);
+            break;
+        default:
+            break;
+    }
+    // Whole vectors always end on a group boundary.
+    const size_t offset = packed_bytes(packing, done);
+    unpack_pixels_scalar(packing, dst + done, src + offset, npixels - done);
+#else
+    unpack_pixels_scalar(packing, dst, src, npixels);
+#endif
+}
@@ -0,0 +1,48 @@
+/// @file Unpacking of bit-packed GenICam pixel formats.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_PIXEL_UNPACK_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_PIXEL_UNPACK_V0
+
+#include <cstddef>
+#include <cstdint>
+
+/// How pixels are laid out in the grabber's buffers.
+///
+/// Packed formats follow the GenICam Pixel Format Naming Convention: pixels
+/// are stored back to back with no padding, least significant bit first.
+enum class PixelPacking
+{
+    None,    ///< One pixel per 8- or 16-bit container.
+    Mono10p, ///< 4 pixels in 5 bytes.
+    Mono12p, ///< 2 pixels in 3 bytes.
+};
+
+/// Smallest run of pixels that starts and ends on a byte boundary.
+struct PixelGroup
+{
+    size_t pixels;
+    size_t bytes;
+};
+
+PixelGroup
+pixel_group(PixelPacking packing);
+
+/// Bytes occupied by `npixels` packed pixels.
+size_t
+packed_bytes(PixelPacking packing, size_t npixels);
+
+/// Unpacks `npixels` pixels from `src` into 16-bit containers at `dst`.
+/// Uses AVX2 when available. Any pixel count and alignment is allowed.
+void
+unpack_pixels(PixelPacking packing,
+              uint16_t* dst,
+              const uint8_t* src,
+              size_t npixels);
+
+/// Portable reference implementation of `unpack_pixels()`.
+void
+unpack_pixels_scalar(PixelPacking packing,
+                     uint16_t* dst,
+                     const uint8_t* src,
+                     size_t npixels);
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_PIXEL_UNPACK_V0
@@ -0,0 +1,145 @@
+/// @file Bounded single-producer/single-consumer ring.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_SPSC_RING_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_SPSC_RING_V0
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/// Bounded ring for handing items from exactly one producer thread to
+/// exactly one consumer thread.
+///
+/// `try_push()` and `try_pop()` are lock-free. A consumer that wants to block
+/// until an item arrives uses `wait_for()`; the producer only touches the
+/// mutex when a consumer is actually sleeping.
+///
+/// The producer tracks the occupancy high-water mark and the number of
+/// rejected pushes.
+template<typename T>
+struct SpscRing final
+{
+    explicit SpscRing(size_t capacity)
+      : slots_(capacity ? capacity : 1)
+      , head_(0)
+      , tail_(0)
+      , high_water_(0)
+      , overflows_(0)
+      , consumer_waiting_(false)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// Producer. Returns false, leaving `v` untouched, when the ring is full.
+    bool try_push(T& v)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        if (tail - head == slots_.size()) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots_[tail % slots_.size()] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+
+        const size_t n = tail + 1 - head;
+        if (n > high_water_.load(std::memory_order_relaxed))
+            high_water_.store(n, std::memory_order_relaxed);
+
+        // Pairs with the fence in wait_for(). Either the consumer sees the
+        // new tail before sleeping, or we see that it's waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_relaxed))
+            wake();
+        return true;
+    }
+
+    /// Consumer. Returns false when the ring is empty.
+    bool try_pop(T& out)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        out = std::move(slots_[head % slots_.size()]);
+        slots_[head % slots_.size()] = T{};
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer. Blocks until an item is available, `wake()` is called, or
+    /// `timeout` elapses. Returns true if an item may be available.
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        consumer_waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const bool ready = cv_.wait_for(lock, timeout, [this] {
+            return !empty() || woken_;
+        });
+        consumer_waiting_.store(false, std::memory_order_relaxed);
+        woken_ = false;
+        return ready;
+    }
+
+    /// Wakes a consumer blocked in `wait_for()`. Safe from any thread.
+    void wake()
+    {
+        {
+            const std::scoped_lock lock(lock_);
+            woken_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t high_water() const { return high_water_.load(); }
+    uint64_t overflows() const { return overflows_.load(); }
+
+    /// Empties the ring and changes its capacity.
+    /// Not thread-safe. Only call while neither side is running.
+    void reset(size_t capacity)
+    {
+        slots_.clear();
+        slots_.resize(capacity ? capacity : 1);
+        head_ = tail_ = 0;
+        high_water_ = 0;
+        overflows_ = 0;
+        woken_ = false;
+    }
+
+  private:
+    std::vector<T> slots_;
+
+    // Indices grow without bound and are reduced modulo capacity.
+    alignas(64) std::atomic<size_t> head_; // next slot to pop
+    alignas(64) std::atomic<size_t> tail_; // next slot to push
+
+    alignas(64) std::atomic<size_t> high_water_;
+    std::atomic<uint64_t> overflows_;
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::atomic<bool> consumer_waiting_;
+    bool woken_ = false; // guarded by lock_
+};
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_SPSC_RING_V0
@@ -0,0 +1,83 @@
+#include "thread.priority.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+bool
+set_current_thread_priority(int priority, std::string* error)
+{
+#ifdef _WIN32
+    if (SetThreadPriority(GetCurrentThread(),
+                          priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL
+                                       : THREAD_PRIORITY_NORMAL))
+        return true;
+    if (error)
+        *error = "SetThreadPriority failed with error " +
+                 std::to_string(GetLastError());
+    return false;
+#else
+    sched_param param = {};
+    int policy = SCHED_OTHER;
+    if (priority > 0) {
+        policy = SCHED_FIFO;
+        param.sched_priority = std::clamp(priority,
+                                          sched_get_priority_min(SCHED_FIFO),
+                                          sched_get_priority_max(SCHED_FIFO));
+    }
+    const int ecode = pthread_setschedparam(pthread_self(), policy, &param);
+    if (!ecode)
+        return true;
+    if (error) {
+        *error = strerror(ecode);
+        if (ecode == EPERM)
+            *error += " (needs CAP_SYS_NICE or an RLIMIT_RTPRIO of at least " +
+                      std::to_string(param.sched_priority) + ")";
+    }
+    return false;
+#endif
+}
+
+bool
+lock_process_memory(std::string* error)
+{
+#ifdef _WIN32
+    // Windows can only lock given ranges (VirtualLock), within the working
+    // set. The driver-allocated buffers are locked on their own.
+    if (error)
+        *error = "not supported on Windows";
+    return false;
+#else
+    if (0 == mlockall(MCL_CURRENT))
+        return true;
+    if (error) {
+        *error = strerror(errno);
+        if (errno == ENOMEM || errno == EPERM)
+            *error += " (RLIMIT_MEMLOCK too low?)";
+    }
+    return false;
+#endif
+}
+
+std::optional<uint64_t>
+current_thread_run_delay_ns()
+{
+#ifdef __linux__
+    // Time on the CPU, time waiting on a run queue, and time slices, in ns.
+    std::ifstream file("/proc/thread-self/schedstat");
+    uint64_t on_cpu_ns = 0, run_delay_ns = 0;
+    if (file >> on_cpu_ns >> run_delay_ns)
+        return run_delay_ns;
+#endif
+    return std::nullopt;
+}
@@ -0,0 +1,25 @@
+/// @file Real-time scheduling for the threads on the acquisition path.
+#ifndef H_ACQUIRE_DRIVER_EGRABBER_THREAD_PRIORITY_V0
+#define H_ACQUIRE_DRIVER_EGRABBER_THREAD_PRIORITY_V0
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/// Runs the calling thread at real-time `priority` (SCHED_FIFO on Linux,
+/// time critical on Windows), or back at normal priority for 0. On failure
+/// the scheduling is unchanged and `error` says why.
+bool
+set_current_thread_priority(int priority, std::string* error);
+
+/// Locks all the pages currently mapped by the process in RAM, including the
+/// host application's. Pages mapped later aren't affected.
+bool
+lock_process_memory(std::string* error);
+
+/// Total time the calling thread has spent runnable but waiting for a CPU.
+/// std::nullopt where the platform doesn't say (Linux only).
+std::optional<uint64_t>
+current_thread_run_delay_ns();
+
+#endif // H_ACQUIRE_DRIVER_EGRABBER_THREAD_PRIORITY_V0
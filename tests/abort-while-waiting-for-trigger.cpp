@@ -42,6 +42,10 @@ reporter(int is_error,
 #define DEVOK(e) CHECK(Device_Ok == (e))
 #define OK(e) CHECK(AcquireStatus_Ok == (e))
 
+// Upper bound on how long acquire_abort() may take while the camera is
+// waiting on a trigger that never comes.
+constexpr double MAX_ABORT_LATENCY_MS = 250.0;
+
 int
 main()
 {
@@ -65,7 +69,17 @@ main()
         OK(acquire_configure(runtime, &props));
         OK(acquire_start(runtime));
         clock_sleep_ms(0, 500);
-        OK(acquire_abort(runtime));
+        {
+            struct clock clock;
+            clock_init(&clock);
+            OK(acquire_abort(runtime));
+            const double elapsed_ms = clock_toc_ms(&clock);
+            LOG("Abort took %f ms", elapsed_ms);
+            EXPECT(elapsed_ms < MAX_ABORT_LATENCY_MS,
+                   "Abort took %f ms. Expected less than %f ms.",
+                   elapsed_ms,
+                   MAX_ABORT_LATENCY_MS);
+        }
         OK(acquire_shutdown(runtime));
         return 0;
     } catch (const std::runtime_error& e) {
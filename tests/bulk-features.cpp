@@ -0,0 +1,184 @@
+/// @file
+/// @brief Reads and writes camera features in bulk through registered handles.
+/// Checks that bulk writes of shadowed settings are seen by `get`, and that
+/// unknown features and bad handles fail without affecting the others.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+#define countof(e) (sizeof(e) / sizeof(*(e)))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto register_features = (egrabber_camera_register_features_t)lib_load(
+          &lib, "egrabber_camera_register_features");
+        auto get_features = (egrabber_camera_get_features_t)lib_load(
+          &lib, "egrabber_camera_get_features");
+        auto set_features = (egrabber_camera_set_features_t)lib_load(
+          &lib, "egrabber_camera_set_features");
+        CHECK(init);
+        CHECK(register_features);
+        CHECK(get_features);
+        CHECK(set_features);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        const struct EGrabberFeature features[] = {
+            { "ExposureTime",
+              EGrabberModule_Remote,
+              EGrabberFeatureType_Float },
+            { "Width", EGrabberModule_Remote, EGrabberFeatureType_Integer },
+            { "PixelFormat",
+              EGrabberModule_Remote,
+              EGrabberFeatureType_String },
+            { "DeviceVendorName",
+              EGrabberModule_Remote,
+              EGrabberFeatureType_String },
+        };
+        const uint32_t n = countof(features);
+        uint32_t handles[countof(features)] = {};
+        DEVOK(register_features(camera, features, n, handles));
+        for (uint32_t i = 0; i < n; ++i)
+            CHECK(handles[i] != EGRABBER_INVALID_FEATURE);
+
+        // Resolving again hands back the same handles.
+        {
+            uint32_t again[countof(features)] = {};
+            DEVOK(register_features(camera, features, n, again));
+            CHECK(0 == memcmp(handles, again, sizeof(handles)));
+        }
+
+        struct EGrabberFeatureValue values[countof(features)] = {};
+        for (uint32_t i = 0; i < n; ++i)
+            values[i].handle = handles[i];
+        DEVOK(get_features(camera, values, n));
+        for (uint32_t i = 0; i < n; ++i)
+            CHECK(values[i].status == Device_Ok);
+        LOG("ExposureTime %f, Width %lld, PixelFormat %s, vendor %s",
+            values[0].number,
+            (long long)values[1].integer,
+            values[2].string,
+            values[3].string);
+        CHECK(values[1].integer > 0);
+        CHECK(strlen(values[3].string) > 0);
+
+        struct CameraPropertyMetadata meta = {};
+        DEVOK(camera->get_meta(camera, &meta));
+        const double target_us = std::round(
+          0.25 * (meta.exposure_time_us.low + meta.exposure_time_us.high));
+
+        // Write ExposureTime in bulk. `get` answers from the shadow copy,
+        // so it must see the new value without a refresh.
+        {
+            struct EGrabberFeatureValue write = { .handle = handles[0],
+                                                  .number = target_us };
+            DEVOK(set_features(camera, &write, 1));
+            CHECK(write.status == Device_Ok);
+
+            struct CameraProperties props = {};
+            DEVOK(camera->get(camera, &props));
+            EXPECT(fabs(props.exposure_time_us - target_us) < 1,
+                   "Exposure time: get %f, written %f",
+                   props.exposure_time_us,
+                   target_us);
+
+            DEVOK(get_features(camera, values, 1));
+            EXPECT(fabs(values[0].number - target_us) < 1,
+                   "Exposure time: read %f, written %f",
+                   values[0].number,
+                   target_us);
+        }
+
+        // An unknown feature gets the invalid handle. The others in the same
+        // call are still registered.
+        {
+            const struct EGrabberFeature mixed[] = {
+                { "NotARealFeature",
+                  EGrabberModule_Remote,
+                  EGrabberFeatureType_Integer },
+                { "Width", EGrabberModule_Remote, EGrabberFeatureType_Integer },
+            };
+            uint32_t h[2] = {};
+            CHECK(Device_Err == register_features(camera, mixed, 2, h));
+            CHECK(h[0] == EGRABBER_INVALID_FEATURE);
+            CHECK(h[1] == handles[1]);
+        }
+
+        // A bad handle fails on its own.
+        {
+            struct EGrabberFeatureValue v[2] = {
+                { .handle = EGRABBER_INVALID_FEATURE },
+                { .handle = handles[1] },
+            };
+            CHECK(Device_Err == get_features(camera, v, 2));
+            CHECK(v[0].status == Device_Err);
+            CHECK(v[1].status == Device_Ok);
+            CHECK(v[1].integer == values[1].integer);
+        }
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,126 @@
+/// @file
+/// @brief Camera properties read from the shadow cache match the device.
+/// Changes a few settings, then compares `get` against
+/// `egrabber_camera_refresh_properties`, which reads them back from the
+/// camera.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto refresh = (egrabber_camera_refresh_properties_t)lib_load(
+          &lib, "egrabber_camera_refresh_properties");
+        CHECK(init);
+        CHECK(refresh);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraPropertyMetadata meta = {};
+        DEVOK(camera->get_meta(camera, &meta));
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.exposure_time_us = 0.5f * (meta.exposure_time_us.low +
+                                         meta.exposure_time_us.high);
+        // Half the sensor, keeping to the usual 16 pixel increment.
+        props.shape.x = (uint32_t)meta.shape.x.high / 32 * 16;
+        props.shape.y = (uint32_t)meta.shape.y.high / 32 * 16;
+        props.input_triggers.frame_start.enable = 0;
+        DEVOK(camera->set(camera, &props));
+
+        struct CameraProperties cached = {};
+        {
+            const auto t0 = std::chrono::steady_clock::now();
+            DEVOK(camera->get(camera, &cached));
+            const std::chrono::duration<double, std::micro> dt =
+              std::chrono::steady_clock::now() - t0;
+            LOG("get took %f us", dt.count());
+        }
+
+        struct CameraProperties fresh = {};
+        DEVOK(refresh(camera, &fresh));
+
+        EXPECT(cached.exposure_time_us == fresh.exposure_time_us,
+               "Exposure time: cached %f, device %f",
+               cached.exposure_time_us,
+               fresh.exposure_time_us);
+        CHECK(cached.binning == fresh.binning);
+        CHECK(cached.pixel_type == fresh.pixel_type);
+        CHECK(cached.offset.x == fresh.offset.x);
+        CHECK(cached.offset.y == fresh.offset.y);
+        CHECK(cached.shape.x == fresh.shape.x);
+        CHECK(cached.shape.y == fresh.shape.y);
+        CHECK(cached.shape.x == props.shape.x);
+        CHECK(cached.shape.y == props.shape.y);
+        CHECK(0 == memcmp(&cached.input_triggers.frame_start,
+                          &fresh.input_triggers.frame_start,
+                          sizeof(struct Trigger)));
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
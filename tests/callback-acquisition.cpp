@@ -0,0 +1,150 @@
+/// @file
+/// @brief Acquires with buffers delivered by the grabber's callbacks
+/// (`EGrabberAcquisition_Callback`) instead of an acquisition thread.
+/// Streams, restarts, and checks a software trigger is matched to its frame.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto set_mode = (egrabber_driver_set_acquisition_mode_t)lib_load(
+          &lib, "egrabber_driver_set_acquisition_mode");
+        auto try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame");
+        auto get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats");
+        CHECK(init);
+        CHECK(set_mode);
+        CHECK(try_get_frame);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        CHECK(Device_Err ==
+              set_mode(driver, (enum EGrabberAcquisitionMode)1000));
+        DEVOK(set_mode(driver, EGrabberAcquisition_Callback));
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.exposure_time_us = 1000;
+        props.input_triggers.frame_start.enable = 0;
+        DEVOK(camera->set(camera, &props));
+
+        struct ImageShape shape = {};
+        DEVOK(camera->get_shape(camera, &shape));
+        std::vector<uint8_t> im(shape.strides.planes * 2);
+
+        // Free-running, twice, to check buffers come back after a restart.
+        for (int run = 0; run < 2; ++run) {
+            DEVOK(camera->start(camera));
+            const int nframes = 20;
+            uint64_t last_id = 0;
+            for (int i = 0; i < nframes; ++i) {
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                CHECK(EGrabberFrame_Ok ==
+                      try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+                if (i)
+                    CHECK(info.hardware_frame_id > last_id);
+                last_id = info.hardware_frame_id;
+            }
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            EXPECT(stats.frames_acquired >= (uint64_t)nframes,
+                   "Acquired %llu frames",
+                   (unsigned long long)stats.frames_acquired);
+            DEVOK(camera->stop(camera));
+        }
+
+        // Software triggered. The callback thread matches the trigger with
+        // its frame.
+        props.input_triggers.frame_start = {
+            .enable = 1,
+            .line = 1, // Software
+            .kind = Signal_Input,
+            .edge = TriggerEdge_Rising,
+        };
+        DEVOK(camera->set(camera, &props));
+        DEVOK(camera->start(camera));
+        {
+            DEVOK(camera->execute_trigger(camera));
+            struct ImageInfo info = {};
+            size_t nbytes = im.size();
+            CHECK(EGrabberFrame_Ok ==
+                  try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            CHECK(stats.triggered_frames == 1);
+            LOG("Trigger to frame latency: %f us",
+                stats.trigger_latency_mean_us);
+        }
+        DEVOK(camera->stop(camera));
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,320 @@
+/// @file
+/// @brief Acquires from a group of cameras and checks frames come back in
+/// matching sets: software triggered and matched by frame id, free-running
+/// and matched by timestamp, and, against the simulated grabber, triggered
+/// together on Line0. Also triggers and stops the group from one thread
+/// while another waits for frame sets.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+#define MAX_CAMERAS 2
+
+// How soon a consumer waiting for a frame set returns once the group is
+// stopped from another thread.
+constexpr double MAX_STOP_RETURN_MS = 100.0;
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    // The simulated grabber finds one camera, and never drives Line0, by
+    // default.
+#ifdef _WIN32
+    if (!getenv("ACQUIRE_EGRABBER_SIM_CAMERAS"))
+        _putenv_s("ACQUIRE_EGRABBER_SIM_CAMERAS", "2");
+    if (!getenv("ACQUIRE_EGRABBER_SIM_LINE0_HZ"))
+        _putenv_s("ACQUIRE_EGRABBER_SIM_LINE0_HZ", "200");
+#else
+    setenv("ACQUIRE_EGRABBER_SIM_CAMERAS", "2", 0);
+    setenv("ACQUIRE_EGRABBER_SIM_LINE0_HZ", "200", 0);
+#endif
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Camera* cameras[MAX_CAMERAS] = {};
+    uint32_t ncameras = 0;
+    struct EGrabberGroup* group = nullptr;
+    egrabber_group_destroy_t destroy = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto create = (egrabber_driver_create_group_t)lib_load(
+          &lib, "egrabber_driver_create_group");
+        destroy =
+          (egrabber_group_destroy_t)lib_load(&lib, "egrabber_group_destroy");
+        auto start =
+          (egrabber_group_start_t)lib_load(&lib, "egrabber_group_start");
+        auto stop =
+          (egrabber_group_stop_t)lib_load(&lib, "egrabber_group_stop");
+        auto trigger = (egrabber_group_execute_trigger_t)lib_load(
+          &lib, "egrabber_group_execute_trigger");
+        auto get_set = (egrabber_group_get_frame_set_t)lib_load(
+          &lib, "egrabber_group_get_frame_set");
+        auto release_set = (egrabber_group_release_frame_set_t)lib_load(
+          &lib, "egrabber_group_release_frame_set");
+        auto get_stats = (egrabber_group_get_stats_t)lib_load(
+          &lib, "egrabber_group_get_stats");
+        CHECK(init);
+        CHECK(create);
+        CHECK(destroy);
+        CHECK(start);
+        CHECK(stop);
+        CHECK(trigger);
+        CHECK(get_set);
+        CHECK(release_set);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        const uint32_t count = driver->device_count(driver);
+        CHECK(count > 0);
+        struct DeviceIdentifier id = {};
+        DEVOK(driver->describe(driver, &id, 0));
+        const bool simulated = strstr(id.name, "(simulated)") != nullptr;
+
+        ncameras = count < MAX_CAMERAS ? count : MAX_CAMERAS;
+        for (uint32_t i = 0; i < ncameras; ++i) {
+            struct Device* device = nullptr;
+            DEVOK(driver->open(driver, i, &device));
+            cameras[i] = (struct Camera*)device;
+
+            struct CameraProperties props = {};
+            DEVOK(cameras[i]->get(cameras[i], &props));
+            props.exposure_time_us = 1000;
+            props.shape = { .x = 256, .y = 256 };
+            props.input_triggers.frame_start.enable = 0;
+            DEVOK(cameras[i]->set(cameras[i], &props));
+        }
+        LOG("Grouping %d camera(s)", (int)ncameras);
+
+        struct EGrabberFrameLease set[MAX_CAMERAS] = {};
+
+        // Software triggered, matched by frame id.
+        {
+            const struct EGrabberGroupConfig config = {
+                .alignment = EGrabberGroupAlignment_FrameId,
+                .frame_start = { .enable = 1,
+                                 .line = 1, // Software
+                                 .kind = Signal_Input,
+                                 .edge = TriggerEdge_Rising },
+            };
+            DEVOK(create(driver, cameras, ncameras, &config, &group));
+            // A camera can't be in two groups, or be closed while grouped.
+            {
+                struct EGrabberGroup* other = nullptr;
+                CHECK(Device_Err ==
+                      create(driver, cameras, ncameras, &config, &other));
+                CHECK(Device_Err ==
+                      driver->close(driver, (struct Device*)cameras[0]));
+            }
+
+            DEVOK(start(group));
+            CHECK(EGrabberFrame_Timeout == get_set(group, set, 50));
+            // Frame ids count from each camera's first frame.
+            uint64_t first[MAX_CAMERAS] = {};
+            for (int i = 0; i < 10; ++i) {
+                DEVOK(trigger(group));
+                CHECK(EGrabberFrame_Ok == get_set(group, set, 1000));
+                for (uint32_t c = 0; c < ncameras; ++c) {
+                    if (i == 0)
+                        first[c] = set[c].info.hardware_frame_id;
+                    CHECK(set[c].info.hardware_frame_id - first[c] ==
+                          set[0].info.hardware_frame_id - first[0]);
+                }
+                for (uint32_t c = 0; c < ncameras; ++c)
+                    CHECK(set[c].data);
+                DEVOK(release_set(group, set));
+            }
+            struct EGrabberGroupStats stats = {};
+            DEVOK(get_stats(group, &stats));
+            CHECK(stats.frame_sets == 10);
+            LOG("Start skew %f ms, set skew %f us",
+                stats.start_skew_ms,
+                stats.set_skew_max_us);
+            DEVOK(stop(group));
+            CHECK(EGrabberFrame_Stopped == get_set(group, set, 1000));
+
+            // A consumer waits for sets on its own thread while this one
+            // triggers, then stops the group. Its first wait has a finite
+            // timeout too long to be added to the clock, which must not
+            // time out at once.
+            DEVOK(start(group));
+            std::atomic<int> sets = 0;
+            std::atomic<int> status = -1;
+            std::atomic<bool> done = false;
+            std::chrono::steady_clock::time_point returned;
+            std::thread consumer([&] {
+                struct EGrabberFrameLease leases[MAX_CAMERAS] = {};
+                uint64_t timeout_ms = EGRABBER_INFINITE - 1;
+                int s;
+                while (EGrabberFrame_Ok ==
+                       (s = get_set(group, leases, timeout_ms))) {
+                    release_set(group, leases);
+                    ++sets;
+                    timeout_ms = EGRABBER_INFINITE;
+                }
+                returned = std::chrono::steady_clock::now();
+                status = s;
+                done = true;
+            });
+            bool triggered = true;
+            for (int i = 0; i < 5; ++i) {
+                const int before = sets;
+                triggered = triggered && Device_Ok == trigger(group);
+                for (int ms = 0; ms < 1000 && sets == before && !done; ++ms)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            // Let the consumer block on a trigger that never comes.
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            const int waited_sets = sets;
+            const auto t0 = std::chrono::steady_clock::now();
+            const bool stopped = Device_Ok == stop(group);
+            for (int ms = 0; ms < 2000 && !done; ++ms)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (!done) {
+                // Can't be joined. Leave it blocked and fail.
+                consumer.detach();
+                EXPECT(false, "Consumer still waiting after stop");
+            }
+            consumer.join();
+            const std::chrono::duration<double, std::milli> return_ms =
+              returned - t0;
+            LOG("Threaded: %d sets, consumer returned %f ms after stop",
+                waited_sets,
+                return_ms.count());
+            CHECK(triggered);
+            CHECK(stopped);
+            CHECK(waited_sets == 5);
+            CHECK(status == EGrabberFrame_Stopped);
+            CHECK(return_ms.count() < MAX_STOP_RETURN_MS);
+
+            DEVOK(destroy(group));
+            group = nullptr;
+        }
+
+        // Free-running, matched by timestamp. Streams at the same rate are
+        // at most half a period apart from their nearest frames.
+        {
+            const struct EGrabberGroupConfig config = {
+                .alignment = EGrabberGroupAlignment_Timestamp,
+                .timestamp_tolerance_us = 6000,
+            };
+            DEVOK(create(driver, cameras, ncameras, &config, &group));
+            for (uint32_t c = 0; c < ncameras; ++c) {
+                struct CameraProperties props = {};
+                DEVOK(cameras[c]->get(cameras[c], &props));
+                props.input_triggers.frame_start.enable = 0;
+                DEVOK(cameras[c]->set(cameras[c], &props));
+            }
+            DEVOK(start(group));
+            for (int i = 0; i < 20; ++i) {
+                CHECK(EGrabberFrame_Ok == get_set(group, set, 1000));
+                for (uint32_t c = 1; c < ncameras; ++c) {
+                    const int64_t dt =
+                      (int64_t)(set[c].info.hardware_timestamp -
+                                set[0].info.hardware_timestamp);
+                    EXPECT(dt <= 6000000 && dt >= -6000000,
+                           "Timestamps %lld ns apart",
+                           (long long)dt);
+                }
+                DEVOK(release_set(group, set));
+            }
+            DEVOK(stop(group));
+            DEVOK(destroy(group));
+            group = nullptr;
+        }
+
+        // Triggered together by a common hardware trigger. Only the
+        // simulated grabber drives Line0 on its own.
+        if (simulated) {
+            const struct EGrabberGroupConfig config = {
+                .alignment = EGrabberGroupAlignment_FrameId,
+                .frame_start = { .enable = 1,
+                                 .line = 0, // Line0
+                                 .kind = Signal_Input,
+                                 .edge = TriggerEdge_Rising },
+            };
+            DEVOK(create(driver, cameras, ncameras, &config, &group));
+            DEVOK(start(group));
+            for (int i = 0; i < 20; ++i) {
+                CHECK(EGrabberFrame_Ok == get_set(group, set, 1000));
+                DEVOK(release_set(group, set));
+            }
+            struct EGrabberGroupStats stats = {};
+            DEVOK(get_stats(group, &stats));
+            LOG("Line0: %llu sets, %llu unmatched, set skew %f us",
+                (unsigned long long)stats.frame_sets,
+                (unsigned long long)stats.unmatched_frames,
+                stats.set_skew_max_us);
+            // Edges are 5 ms apart. Frames of the same edge are much closer.
+            CHECK(stats.set_skew_max_us < 2500);
+            DEVOK(stop(group));
+            DEVOK(destroy(group));
+            group = nullptr;
+        }
+
+        for (uint32_t i = 0; i < ncameras; ++i)
+            DEVOK(driver->close(driver, (struct Device*)cameras[i]));
+        ncameras = 0;
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (group && destroy)
+        destroy(group);
+    if (driver) {
+        for (uint32_t i = 0; i < ncameras; ++i)
+            if (cameras[i])
+                driver->close(driver, (struct Device*)cameras[i]);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,214 @@
+/// @file
+/// @brief Acquires from a camera whose frames arrive over several data
+/// streams, in both acquisition modes, and checks they come out as one
+/// sequence in capture order: free-running, with leases released out of
+/// order, and software triggered.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+#define NLEASES 4
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    // Simulated cameras have a single data stream by default.
+#ifdef _WIN32
+    if (!getenv("ACQUIRE_EGRABBER_SIM_STREAMS"))
+        _putenv_s("ACQUIRE_EGRABBER_SIM_STREAMS", "2");
+#else
+    setenv("ACQUIRE_EGRABBER_SIM_STREAMS", "2", 0);
+#endif
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto set_mode = (egrabber_driver_set_acquisition_mode_t)lib_load(
+          &lib, "egrabber_driver_set_acquisition_mode");
+        auto try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame");
+        auto lease_frame = (egrabber_camera_lease_frame_t)lib_load(
+          &lib, "egrabber_camera_lease_frame");
+        auto release_frame = (egrabber_camera_release_frame_t)lib_load(
+          &lib, "egrabber_camera_release_frame");
+        auto get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats");
+        CHECK(init);
+        CHECK(set_mode);
+        CHECK(try_get_frame);
+        CHECK(lease_frame);
+        CHECK(release_frame);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        struct DeviceIdentifier id = {};
+        DEVOK(driver->describe(driver, &id, 0));
+        const bool simulated = strstr(id.name, "(simulated)") != nullptr;
+
+        const enum EGrabberAcquisitionMode modes[] = {
+            EGrabberAcquisition_Pop,
+            EGrabberAcquisition_Callback,
+        };
+        for (auto mode : modes) {
+            DEVOK(set_mode(driver, mode));
+            DEVOK(driver->open(driver, 0, &device));
+            auto camera = (struct Camera*)device;
+
+            struct CameraProperties props = {};
+            DEVOK(camera->get(camera, &props));
+            props.exposure_time_us = 1000;
+            props.shape = { .x = 256, .y = 256 };
+            props.input_triggers.frame_start.enable = 0;
+            DEVOK(camera->set(camera, &props));
+
+            struct ImageShape shape = {};
+            DEVOK(camera->get_shape(camera, &shape));
+            std::vector<uint8_t> im(shape.strides.planes * 2);
+
+            // Free-running. Frames alternate between the streams and must
+            // come out in order, without gaps.
+            DEVOK(camera->start(camera));
+            {
+                struct EGrabberStats stats = {};
+                DEVOK(get_stats(camera, &stats));
+                LOG("Mode %d: %u data stream(s)",
+                    (int)mode,
+                    (unsigned)stats.data_streams);
+                CHECK(stats.data_streams >= 1);
+                if (simulated)
+                    CHECK(stats.data_streams == 2);
+            }
+            uint64_t last_id = 0, last_timestamp = 0;
+            for (int i = 0; i < 40; ++i) {
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                CHECK(EGrabberFrame_Ok ==
+                      try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+                if (i) {
+                    EXPECT(info.hardware_frame_id == last_id + 1,
+                           "Frame %llu followed frame %llu",
+                           (unsigned long long)info.hardware_frame_id,
+                           (unsigned long long)last_id);
+                    CHECK(info.hardware_timestamp >= last_timestamp);
+                }
+                last_id = info.hardware_frame_id;
+                last_timestamp = info.hardware_timestamp;
+            }
+
+            // Buffers go back to the stream they came from, whatever the
+            // order they're released in.
+            {
+                struct EGrabberFrameLease leases[NLEASES] = {};
+                for (int i = 0; i < NLEASES; ++i) {
+                    DEVOK(lease_frame(camera, &leases[i]));
+                    CHECK(leases[i].info.hardware_frame_id == ++last_id);
+                }
+                for (int i = NLEASES - 1; i >= 0; --i)
+                    DEVOK(release_frame(camera, &leases[i]));
+                for (int i = 0; i < 20; ++i) {
+                    struct ImageInfo info = {};
+                    size_t nbytes = im.size();
+                    CHECK(EGrabberFrame_Ok == try_get_frame(camera,
+                                                            im.data(),
+                                                            &nbytes,
+                                                            &info,
+                                                            1000));
+                }
+            }
+            {
+                struct EGrabberStats stats = {};
+                DEVOK(get_stats(camera, &stats));
+                CHECK(stats.frames_lost == 0);
+                CHECK(stats.queue_overflows == 0);
+            }
+            DEVOK(camera->stop(camera));
+
+            // Software triggered. Each trigger's frame comes from the next
+            // stream in turn.
+            props.input_triggers.frame_start = {
+                .enable = 1,
+                .line = 1, // Software
+                .kind = Signal_Input,
+                .edge = TriggerEdge_Rising,
+            };
+            DEVOK(camera->set(camera, &props));
+            DEVOK(camera->start(camera));
+            for (int i = 0; i < 10; ++i) {
+                DEVOK(camera->execute_trigger(camera));
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                CHECK(EGrabberFrame_Ok ==
+                      try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+                CHECK(info.hardware_frame_id == (uint64_t)i);
+            }
+            {
+                struct EGrabberStats stats = {};
+                DEVOK(get_stats(camera, &stats));
+                CHECK(stats.triggered_frames == 10);
+            }
+            DEVOK(camera->stop(camera));
+
+            DEVOK(driver->close(driver, device));
+            device = nullptr;
+        }
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,124 @@
+/// @file
+/// @brief Leases frames directly from the grabber's buffers.
+/// Exercises the zero-copy extension in `src/euresys.egrabber.h`.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto lease_frame = (egrabber_camera_lease_frame_t)lib_load(
+          &lib, "egrabber_camera_lease_frame");
+        auto release_frame = (egrabber_camera_release_frame_t)lib_load(
+          &lib, "egrabber_camera_release_frame");
+        auto get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats");
+        CHECK(init);
+        CHECK(lease_frame);
+        CHECK(release_frame);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.input_triggers.frame_start.enable = 0;
+        DEVOK(camera->set(camera, &props));
+
+        DEVOK(camera->start(camera));
+        uint64_t last_frame_id = 0;
+        for (int i = 0; i < 10; ++i) {
+            struct EGrabberFrameLease lease = {};
+            DEVOK(lease_frame(camera, &lease));
+            CHECK(lease.data);
+            CHECK(lease.nbytes > 0);
+            CHECK(lease.info.shape.dims.width == props.shape.x);
+            CHECK(lease.info.shape.dims.height == props.shape.y);
+            // Frame ids come from the grabber and only ever increase.
+            EXPECT(i == 0 || lease.info.hardware_frame_id > last_frame_id,
+                   "Frame id went from %llu to %llu",
+                   (unsigned long long)last_frame_id,
+                   (unsigned long long)lease.info.hardware_frame_id);
+            last_frame_id = lease.info.hardware_frame_id;
+            LOG("Leased frame %d: %llu bytes",
+                (int)lease.info.hardware_frame_id,
+                (unsigned long long)lease.nbytes);
+            DEVOK(release_frame(camera, &lease));
+            CHECK(lease.handle == nullptr);
+        }
+        {
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            CHECK(stats.frames_acquired >= 10);
+            LOG("Acquired %llu frames, lost %llu",
+                (unsigned long long)stats.frames_acquired,
+                (unsigned long long)stats.frames_lost);
+        }
+        DEVOK(camera->stop(camera));
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -1,12 +1,17 @@
 /// @file
 /// @brief Lists the devices exposed by this driver.
-/// Exercises the device enumeration interface.
+/// Exercises the device enumeration interface. Enumerates twice, the second
+/// time from the driver's discovery snapshot, and once more after forcing a
+/// new discovery.
 
 #include "platform.h"
 #include "logger.h"
 #include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
 
+#include <chrono>
 #include <cstdio>
+#include <cstring>
 
 #define L aq_logger
 #define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
@@ -47,24 +52,54 @@ main()
 {
     logger_set_reporter(reporter);
     lib lib{};
+    struct Driver* driver = nullptr;
     CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
     {
         auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
-        auto driver = init(reporter);
+        auto refresh = (egrabber_driver_refresh_discovery_t)lib_load(
+          &lib, "egrabber_driver_refresh_discovery");
+        CHECK(init);
+        CHECK(refresh);
+        driver = init(reporter);
         CHECK(driver);
-        const auto n = driver->device_count(driver);
-        for (uint32_t i = 0; i < n; ++i) {
-            DeviceIdentifier id{};
-            char buf[1 << 7] = { 0 };
-            CHECK(driver->describe(driver, &id, i) == Device_Ok);
-            device_identifier_as_debug_string(buf, sizeof(buf), &id);
-            LOG("%d %s", i, buf);
+
+        char names[2][8][sizeof(DeviceIdentifier::name)] = {};
+        uint32_t counts[2] = {};
+        for (int pass = 0; pass < 3; ++pass) {
+            if (pass == 2)
+                CHECK(refresh(driver) == Device_Ok);
+            const auto t0 = std::chrono::steady_clock::now();
+            const auto n = driver->device_count(driver);
+            for (uint32_t i = 0; i < n; ++i) {
+                DeviceIdentifier id{};
+                char buf[1 << 7] = { 0 };
+                CHECK(driver->describe(driver, &id, i) == Device_Ok);
+                device_identifier_as_debug_string(buf, sizeof(buf), &id);
+                LOG("%d %s", i, buf);
+                if (pass < 2 && i < 8)
+                    strcpy(names[pass][i], id.name);
+            }
+            const std::chrono::duration<double, std::milli> dt =
+              std::chrono::steady_clock::now() - t0;
+            LOG("Pass %d: enumerated %d device(s) in %f ms",
+                pass,
+                n,
+                dt.count());
+            if (pass < 2)
+                counts[pass] = n;
         }
+
+        // The snapshot must describe the same devices.
+        CHECK(counts[0] == counts[1]);
+        for (uint32_t i = 0; i < counts[0] && i < 8; ++i)
+            CHECK(0 == strcmp(names[0][i], names[1][i]));
         driver->shutdown(driver);
     }
     lib_close(&lib);
     return 0;
 Error:
+    if (driver)
+        driver->shutdown(driver);
     lib_close(&lib);
     return 1;
 }
@@ -0,0 +1,134 @@
+/// @file
+/// @brief Moves and resizes the region of interest in a single `set` each
+/// time: full frame, a centered quarter of the sensor, its far corner, and
+/// back to full frame. Every step must land exactly, as read back from the
+/// camera with `egrabber_camera_refresh_properties`.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto refresh = (egrabber_camera_refresh_properties_t)lib_load(
+          &lib, "egrabber_camera_refresh_properties");
+        CHECK(init);
+        CHECK(refresh);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.input_triggers.frame_start.enable = 0;
+        struct CameraPropertyMetadata meta = {};
+        DEVOK(camera->get_meta(camera, &meta));
+        // The largest size is what's left of the sensor past the offset.
+        const uint32_t width = props.offset.x + (uint32_t)meta.shape.x.high;
+        const uint32_t height = props.offset.y + (uint32_t)meta.shape.y.high;
+        // A quarter of the sensor, keeping to the usual 16 pixel increment.
+        const uint32_t w = width / 32 * 16, h = height / 32 * 16;
+
+        const struct
+        {
+            const char* name;
+            uint32_t x, y, w, h;
+        } steps[] = {
+            { "full frame", 0, 0, width, height },
+            { "centered", w / 2 / 16 * 16, h / 2 / 16 * 16, w, h },
+            { "far corner", width - w, height - h, w, h },
+            { "full frame", 0, 0, width, height },
+        };
+        for (const auto& step : steps) {
+            props.offset.x = step.x;
+            props.offset.y = step.y;
+            props.shape.x = step.w;
+            props.shape.y = step.h;
+            DEVOK(camera->set(camera, &props));
+
+            struct CameraProperties fresh = {};
+            DEVOK(refresh(camera, &fresh));
+            EXPECT(fresh.offset.x == step.x && fresh.offset.y == step.y &&
+                     fresh.shape.x == step.w && fresh.shape.y == step.h,
+                   "%s: expected %ux%u at (%u, %u). Got %ux%u at (%u, %u).",
+                   step.name,
+                   step.w,
+                   step.h,
+                   step.x,
+                   step.y,
+                   fresh.shape.x,
+                   fresh.shape.y,
+                   fresh.offset.x,
+                   fresh.offset.y);
+            LOG("%s: %ux%u at (%u, %u)",
+                step.name,
+                step.w,
+                step.h,
+                step.x,
+                step.y);
+        }
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,142 @@
+/// @file
+/// @brief Places the buffers on the frame grabber's NUMA node, or on an
+/// explicit one, with the driver's and the producer's buffers. Acquisition
+/// must work with each placement, with or without the node being known.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    // Pin the acquisition and copy threads to node 0, which always exists.
+#ifdef _WIN32
+    _putenv_s("ACQUIRE_EGRABBER_THREAD_NUMA_NODE", "0");
+#else
+    setenv("ACQUIRE_EGRABBER_THREAD_NUMA_NODE", "0", 1);
+#endif
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto set_policy = (egrabber_camera_set_buffer_policy_t)lib_load(
+          &lib, "egrabber_camera_set_buffer_policy");
+        auto get_policy = (egrabber_camera_get_buffer_policy_t)lib_load(
+          &lib, "egrabber_camera_get_buffer_policy");
+        auto try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame");
+        CHECK(init);
+        CHECK(set_policy);
+        CHECK(get_policy);
+        CHECK(try_get_frame);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct EGrabberBufferPolicy policy = {};
+        DEVOK(get_policy(camera, &policy));
+        if (!getenv("ACQUIRE_EGRABBER_NUMA_NODE"))
+            CHECK(policy.numa_node == EGRABBER_NUMA_NODE_GRABBER);
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.exposure_time_us = 1000;
+        props.input_triggers.frame_start.enable = 0;
+        DEVOK(camera->set(camera, &props));
+
+        struct ImageShape shape = {};
+        DEVOK(camera->get_shape(camera, &shape));
+        std::vector<uint8_t> im(shape.strides.planes * 2);
+
+        const struct
+        {
+            uint8_t user_memory;
+            int32_t numa_node;
+        } placements[] = {
+            { 0, EGRABBER_NUMA_NODE_GRABBER },
+            { 0, 0 },
+            { 1, EGRABBER_NUMA_NODE_GRABBER },
+            { 1, 0 },
+            { 1, -1 },
+        };
+        for (const auto& placement : placements) {
+            policy.user_memory = placement.user_memory;
+            policy.numa_node = placement.numa_node;
+            policy.max_count = 8;
+            DEVOK(set_policy(camera, &policy));
+            LOG("User memory: %d, NUMA node: %d",
+                (int)placement.user_memory,
+                (int)placement.numa_node);
+
+            DEVOK(camera->start(camera));
+            for (int i = 0; i < 10; ++i) {
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                CHECK(EGrabberFrame_Ok ==
+                      try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+            }
+            DEVOK(camera->stop(camera));
+        }
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,162 @@
+/// @file
+/// @brief Acquires a 12-bit pixel type, which the driver puts on the wire as
+/// `Mono12p`. Checks that `get_frame` returns unpacked 16-bit pixels and that
+/// leases hand out the packed bytes. Against the simulated grabber, which
+/// fills each image with one byte value, the unpacked pixels are checked
+/// exactly.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+#ifdef ACQUIRE_EGRABBER_SIMULATED
+#ifdef _WIN32
+    _putenv_s("ACQUIRE_EGRABBER_SIM_FILL", "1");
+#else
+    setenv("ACQUIRE_EGRABBER_SIM_FILL", "1", 1);
+#endif
+#endif
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto lease_frame = (egrabber_camera_lease_frame_t)lib_load(
+          &lib, "egrabber_camera_lease_frame");
+        auto release_frame = (egrabber_camera_release_frame_t)lib_load(
+          &lib, "egrabber_camera_release_frame");
+        CHECK(init);
+        CHECK(lease_frame);
+        CHECK(release_frame);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.input_triggers.frame_start.enable = 0;
+        props.pixel_type = SampleType_u12;
+        DEVOK(camera->set(camera, &props));
+        DEVOK(camera->get(camera, &props));
+        CHECK(props.pixel_type == SampleType_u12);
+
+        struct ImageShape shape = {};
+        DEVOK(camera->get_shape(camera, &shape));
+        const size_t npixels =
+          (size_t)shape.dims.width * shape.dims.height;
+        std::vector<uint16_t> im(npixels);
+
+        DEVOK(camera->start(camera));
+        for (int i = 0; i < 5; ++i) {
+            struct ImageInfo info = {};
+            size_t nbytes = im.size() * sizeof(im[0]);
+            DEVOK(camera->get_frame(camera, im.data(), &nbytes, &info));
+            CHECK(nbytes == npixels * sizeof(im[0]));
+            CHECK(info.shape.type == SampleType_u12);
+            for (size_t j = 0; j < npixels; ++j)
+                EXPECT(im[j] < 4096,
+                       "Pixel %llu is %d, beyond 12 bits",
+                       (unsigned long long)j,
+                       (int)im[j]);
+#ifdef ACQUIRE_EGRABBER_SIMULATED
+            {
+                // Every byte after the image's 8-byte sequence number is b:
+                // pixel pairs from 6 on unpack to the same two values.
+                const uint32_t b = im[6] & 0xff;
+                const uint16_t even = (uint16_t)(b | (b & 0xf) << 8);
+                const uint16_t odd = (uint16_t)(((b >> 4) | b << 4) & 0xfff);
+                for (size_t j = 6; j < npixels; ++j)
+                    EXPECT(im[j] == (j % 2 ? odd : even),
+                           "Frame %d: pixel %llu is %d. Expected %d.",
+                           i,
+                           (unsigned long long)j,
+                           (int)im[j],
+                           (int)(j % 2 ? odd : even));
+            }
+#endif
+        }
+        {
+            struct EGrabberFrameLease lease = {};
+            DEVOK(lease_frame(camera, &lease));
+            const auto packing = lease.packing;
+            const size_t nbytes = lease.nbytes;
+#ifdef ACQUIRE_EGRABBER_SIMULATED
+            const auto* data = (const uint8_t*)lease.data;
+            size_t mismatch = 0;
+            for (size_t j = 8; j < nbytes && !mismatch; ++j)
+                mismatch = data[j] != data[0] ? j : 0;
+#endif
+            DEVOK(release_frame(camera, &lease));
+            CHECK(packing == EGrabberPixelPacking_Mono12p);
+            CHECK(nbytes == npixels * 3 / 2);
+#ifdef ACQUIRE_EGRABBER_SIMULATED
+            EXPECT(!mismatch,
+                   "Leased byte %llu differs from the image's fill value",
+                   (unsigned long long)mismatch);
+#endif
+        }
+        DEVOK(camera->stop(camera));
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,132 @@
+/// @file
+/// @brief Receives buffers at real-time priority. Without the permission to
+/// do so, acquisition must still work at normal priority. Checks the
+/// scheduling statistics are reported either way.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto set_priority = (egrabber_camera_set_thread_priority_t)lib_load(
+          &lib, "egrabber_camera_set_thread_priority");
+        auto try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame");
+        auto get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats");
+        CHECK(init);
+        CHECK(set_priority);
+        CHECK(try_get_frame);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        CHECK(Device_Err == set_priority(camera, -1));
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.exposure_time_us = 1000;
+        props.input_triggers.frame_start.enable = 0;
+        DEVOK(camera->set(camera, &props));
+
+        struct ImageShape shape = {};
+        DEVOK(camera->get_shape(camera, &shape));
+        std::vector<uint8_t> im(shape.strides.planes * 2);
+
+        // Real-time, then back to normal priority.
+        const int32_t priorities[] = { 10, 0 };
+        for (const auto priority : priorities) {
+            DEVOK(set_priority(camera, priority));
+            DEVOK(camera->start(camera));
+            const int nframes = 50;
+            for (int i = 0; i < nframes; ++i) {
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                CHECK(EGrabberFrame_Ok ==
+                      try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+            }
+            DEVOK(camera->stop(camera));
+
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            LOG("Priority %d: real-time %d. Receive jitter: mean %f us, max "
+                "%f us. Run queue wait: %f ms.",
+                (int)priority,
+                (int)stats.realtime,
+                stats.receive_jitter_mean_us,
+                stats.receive_jitter_max_us,
+                stats.run_queue_wait_ms);
+            if (!priority)
+                CHECK(!stats.realtime);
+            CHECK(stats.receive_jitter_mean_us >= 0);
+            CHECK(stats.receive_jitter_max_us >= stats.receive_jitter_mean_us);
+            CHECK(stats.run_queue_wait_ms >= 0);
+        }
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
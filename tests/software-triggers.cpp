@@ -0,0 +1,175 @@
+/// @file
+/// @brief Software-triggered acquisition, one trigger at a time and in batches.
+/// Exercises `execute_trigger`, `egrabber_camera_fire_triggers` and the
+/// trigger latency reported by `egrabber_camera_get_stats`, which only counts
+/// software-triggered acquisition, also with Line0 edges coming in.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+int
+main()
+{
+#ifdef _WIN32
+    if (!getenv("ACQUIRE_EGRABBER_SIM_LINE0_HZ"))
+        _putenv_s("ACQUIRE_EGRABBER_SIM_LINE0_HZ", "200");
+#else
+    setenv("ACQUIRE_EGRABBER_SIM_LINE0_HZ", "200", 0);
+#endif
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto fire_triggers = (egrabber_camera_fire_triggers_t)lib_load(
+          &lib, "egrabber_camera_fire_triggers");
+        auto try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame");
+        auto get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats");
+        CHECK(init);
+        CHECK(fire_triggers);
+        CHECK(try_get_frame);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.exposure_time_us = 1000;
+        props.input_triggers.frame_start = {
+            .enable = 1,
+            .line = 1, // Software
+            .kind = Signal_Input,
+            .edge = TriggerEdge_Rising,
+        };
+        DEVOK(camera->set(camera, &props));
+
+        struct ImageShape shape = {};
+        DEVOK(camera->get_shape(camera, &shape));
+        std::vector<uint8_t> im(shape.strides.planes * 2);
+
+        DEVOK(camera->start(camera));
+
+        // One at a time.
+        const int single = 5;
+        for (int i = 0; i < single; ++i) {
+            DEVOK(camera->execute_trigger(camera));
+            struct ImageInfo info = {};
+            size_t nbytes = im.size();
+            CHECK(EGrabberFrame_Ok ==
+                  try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+        }
+
+        // In a batch, 20 ms apart.
+        const uint32_t batch = 10;
+        DEVOK(fire_triggers(camera, batch, 20000));
+        for (uint32_t i = 0; i < batch; ++i) {
+            struct ImageInfo info = {};
+            size_t nbytes = im.size();
+            CHECK(EGrabberFrame_Ok ==
+                  try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+        }
+        {
+            // Nothing was triggered, so nothing should arrive.
+            struct ImageInfo info = {};
+            size_t nbytes = im.size();
+            CHECK(EGrabberFrame_Timeout ==
+                  try_get_frame(camera, im.data(), &nbytes, &info, 100));
+        }
+
+        {
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            CHECK(stats.software_triggers == single + batch);
+            CHECK(stats.triggered_frames == single + batch);
+            CHECK(stats.trigger_latency_max_us >=
+                  stats.trigger_latency_mean_us);
+            LOG("Trigger to frame latency: mean %f us, max %f us",
+                stats.trigger_latency_mean_us,
+                stats.trigger_latency_max_us);
+        }
+        DEVOK(camera->stop(camera));
+
+        // Triggered from Line0, software triggers still produce frames, but
+        // aren't matched with any: the Line0 frames would take their times.
+        props.input_triggers.frame_start.line = 0; // Line0
+        DEVOK(camera->set(camera, &props));
+        DEVOK(camera->start(camera));
+        for (int i = 0; i < single; ++i) {
+            DEVOK(camera->execute_trigger(camera));
+            struct ImageInfo info = {};
+            size_t nbytes = im.size();
+            CHECK(EGrabberFrame_Ok ==
+                  try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+        }
+        {
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            CHECK(stats.software_triggers == single);
+            CHECK(stats.triggered_frames == 0);
+        }
+        DEVOK(camera->stop(camera));
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,179 @@
+/// @file
+/// @brief Stopping while a consumer waits for a software trigger that never
+/// comes. The waiting `try_get_frame` must return, and `stop` complete,
+/// within a bounded time. The driver's share of the stop is checked through
+/// the phases reported by `egrabber_camera_get_stats`. Also checks that the
+/// next acquisition is unaffected.
+
+#include "platform.h"
+#include "logger.h"
+#include "device/kit/driver.h"
+#include "src/euresys.egrabber.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+#define DEVOK(e) CHECK(Device_Ok == (e))
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+typedef struct Driver* (*init_func_t)(void (*reporter)(int is_error,
+                                                       const char* file,
+                                                       int line,
+                                                       const char* function,
+                                                       const char* msg));
+
+// A waiting consumer is released before anything is torn down, so it
+// returns quickly whatever the grabber. The unblock and join phases of the
+// driver's stop don't depend on the grabber either. Stopping a real camera
+// also waits on the grabber and on writes to the camera, which the whole
+// stop, as timed by the driver and by the caller, is bounded for.
+constexpr double MAX_RETURN_LATENCY_MS = 10.0;
+constexpr double MAX_RELEASE_LATENCY_MS = 10.0;
+#ifdef ACQUIRE_EGRABBER_SIMULATED
+constexpr double MAX_DRIVER_STOP_MS = 10.0;
+#else
+constexpr double MAX_DRIVER_STOP_MS = 250.0;
+#endif
+constexpr double MAX_STOP_LATENCY_MS = 250.0;
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    lib lib{};
+    struct Driver* driver = nullptr;
+    struct Device* device = nullptr;
+    CHECK(lib_open_by_name(&lib, "acquire-driver-egrabber"));
+    {
+        auto init = (init_func_t)lib_load(&lib, "acquire_driver_init_v0");
+        auto try_get_frame = (egrabber_camera_try_get_frame_t)lib_load(
+          &lib, "egrabber_camera_try_get_frame");
+        auto get_stats = (egrabber_camera_get_stats_t)lib_load(
+          &lib, "egrabber_camera_get_stats");
+        CHECK(init);
+        CHECK(try_get_frame);
+        CHECK(get_stats);
+
+        driver = init(reporter);
+        CHECK(driver);
+        CHECK(driver->device_count(driver) > 0);
+        DEVOK(driver->open(driver, 0, &device));
+        auto camera = (struct Camera*)device;
+
+        struct CameraProperties props = {};
+        DEVOK(camera->get(camera, &props));
+        props.exposure_time_us = 1000;
+        props.input_triggers.frame_start = {
+            .enable = 1,
+            .line = 1, // Software
+            .kind = Signal_Input,
+            .edge = TriggerEdge_Rising,
+        };
+
+        struct ImageShape shape = {};
+        DEVOK(camera->get_shape(camera, &shape));
+        std::vector<uint8_t> im(shape.strides.planes * 2);
+
+        for (int cycle = 0; cycle < 5; ++cycle) {
+            // stop turns triggering off.
+            DEVOK(camera->set(camera, &props));
+            DEVOK(camera->start(camera));
+
+            // The previous stop must not leave a cancelled pop behind.
+            DEVOK(camera->execute_trigger(camera));
+            {
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                CHECK(EGrabberFrame_Ok ==
+                      try_get_frame(camera, im.data(), &nbytes, &info, 1000));
+            }
+
+            // Wait for a trigger that never comes.
+            std::atomic<int> status = -1;
+            std::chrono::steady_clock::time_point returned;
+            std::thread consumer([&] {
+                struct ImageInfo info = {};
+                size_t nbytes = im.size();
+                const auto s = try_get_frame(
+                  camera, im.data(), &nbytes, &info, EGRABBER_INFINITE);
+                returned = std::chrono::steady_clock::now();
+                status = s;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            const auto t0 = std::chrono::steady_clock::now();
+            const auto ecode = camera->stop(camera);
+            const std::chrono::duration<double, std::milli> stop_ms =
+              std::chrono::steady_clock::now() - t0;
+            consumer.join();
+            const std::chrono::duration<double, std::milli> return_ms =
+              returned - t0;
+
+            DEVOK(ecode);
+            CHECK(status == EGrabberFrame_Stopped);
+            struct EGrabberStats stats = {};
+            DEVOK(get_stats(camera, &stats));
+            LOG("Cycle %d: consumer returned after %f ms, stop took %f ms "
+                "(unblock %f ms, join %f ms, grabber %f ms, settings %f ms)",
+                cycle,
+                return_ms.count(),
+                stop_ms.count(),
+                stats.stop_unblock_ms,
+                stats.stop_join_ms,
+                stats.stop_grabber_ms,
+                stats.stop_settings_ms);
+            CHECK(return_ms.count() < MAX_RETURN_LATENCY_MS);
+            CHECK(stop_ms.count() < MAX_STOP_LATENCY_MS);
+            CHECK(stats.stop_unblock_ms + stats.stop_join_ms <
+                  MAX_RELEASE_LATENCY_MS);
+            CHECK(stats.last_stop_ms < MAX_DRIVER_STOP_MS);
+            CHECK(stats.last_stop_ms <= stop_ms.count());
+            CHECK(stats.last_stop_ms >=
+                  stats.stop_unblock_ms + stats.stop_join_ms +
+                    stats.stop_grabber_ms + stats.stop_settings_ms - 1e-3);
+        }
+
+        DEVOK(driver->close(driver, device));
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 0;
+Error:
+    if (driver) {
+        if (device)
+            driver->close(driver, device);
+        driver->shutdown(driver);
+    }
+    lib_close(&lib);
+    return 1;
+}
@@ -0,0 +1,131 @@
+/// @file
+/// @brief Packed pixel unpacking against the portable reference.
+/// Unpacks `Mono10p` and `Mono12p` runs of awkward lengths and alignments
+/// with `unpack_pixels` (AVX2 where available) and with the `CopyEngine`
+/// worker pool, and compares the result with `unpack_pixels_scalar`.
+/// Sources are allocated to their exact packed size, so an over-read shows
+/// up under a memory checker, and a canary after the destination catches
+/// over-writes.
+
+#include "logger.h"
+#include "src/copy.engine.hh"
+#include "src/pixel.unpack.hh"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define L aq_logger
+#define LOG(...) L(0, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define LOGE(...) L(1, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+#define EXPECT(e, ...)                                                         \
+    do {                                                                       \
+        if (!(e)) {                                                            \
+            LOGE(__VA_ARGS__);                                                 \
+            goto Error;                                                        \
+        }                                                                      \
+    } while (0)
+#define CHECK(e) EXPECT(e, "Expression evaluated as false:\n\t%s", #e)
+
+void
+reporter(int is_error,
+         const char* file,
+         int line,
+         const char* function,
+         const char* msg)
+{
+    fprintf(is_error ? stderr : stdout,
+            "%s%s(%d) - %s: %s\n",
+            is_error ? "ERROR " : "",
+            file,
+            line,
+            function,
+            msg);
+}
+
+constexpr uint16_t CANARY = 0xdead;
+
+/// Unpacks `npixels` from `src` with `unpack` and checks the result against
+/// `expected`. Returns the index of the first wrong pixel, `npixels` for
+/// an overwritten canary, or -1 if all is well.
+template<typename F>
+long long
+first_mismatch(const std::vector<uint16_t>& expected, size_t npixels, F unpack)
+{
+    std::vector<uint16_t> out(npixels + 1, 0);
+    out[npixels] = CANARY;
+    unpack(out.data());
+    for (size_t i = 0; i < npixels; ++i) {
+        if (out[i] != expected[i])
+            return (long long)i;
+    }
+    return out[npixels] == CANARY ? -1 : (long long)npixels;
+}
+
+int
+main()
+{
+    logger_set_reporter(reporter);
+    const PixelPacking packings[] = { PixelPacking::Mono10p,
+                                      PixelPacking::Mono12p };
+    // Around the group and vector widths, and a frame-sized odd count.
+    const size_t counts[] = { 0,  1,  2,  3,  4,  5,   7,   8,   9,    15,
+                              16, 17, 31, 32, 33, 63,  64,  65,  127,  129,
+                              255, 257, 1023, 1025, 4099, 1000003 };
+    // Several workers and no threshold, so the pool splits every run.
+    CopyEngine engine(3, 0);
+
+    for (const auto packing : packings) {
+        const char* name =
+          packing == PixelPacking::Mono10p ? "Mono10p" : "Mono12p";
+        for (const size_t npixels : counts) {
+            for (const size_t misalign : { 0, 1 }) {
+                const size_t nbytes = packed_bytes(packing, npixels);
+                std::vector<uint8_t> storage(misalign + nbytes);
+                for (size_t i = 0; i < storage.size(); ++i)
+                    storage[i] = (uint8_t)(i * 151 + 17);
+                const uint8_t* src = storage.data() + misalign;
+
+                std::vector<uint16_t> expected(npixels);
+                unpack_pixels_scalar(packing, expected.data(), src, npixels);
+                {
+                    // Every value must fit the pixel's bit depth.
+                    const uint16_t limit =
+                      packing == PixelPacking::Mono10p ? 1024 : 4096;
+                    for (const auto v : expected)
+                        CHECK(v < limit);
+                }
+
+                const auto simd = first_mismatch(
+                  expected, npixels, [&](uint16_t* dst) {
+                      unpack_pixels(packing, dst, src, npixels);
+                  });
+                EXPECT(simd < 0,
+                       "%s: unpack_pixels differs at pixel %lld of %llu "
+                       "(source offset %d)",
+                       name,
+                       simd,
+                       (unsigned long long)npixels,
+                       (int)misalign);
+
+                const auto pool = first_mismatch(
+                  expected, npixels, [&](uint16_t* dst) {
+                      engine.unpack(dst, src, npixels, packing);
+                  });
+                EXPECT(pool < 0,
+                       "%s: CopyEngine::unpack differs at pixel %lld of "
+                       "%llu (source offset %d)",
+                       name,
+                       pool,
+                       (unsigned long long)npixels,
+                       (int)misalign);
+            }
+        }
+        LOG("%s: %d pixel counts match the reference",
+            name,
+            (int)(sizeof(counts) / sizeof(*counts)));
+    }
+    return 0;
+Error:
+    return 1;
+}